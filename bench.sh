@@ -0,0 +1,118 @@
+#!/bin/bash
+# Sweeps fish, food, world size, eyes and threads over orders of magnitude
+# and reports how each phase of a tick scales, then weighs the sensing
+# schedules' speed against their fitness.
+#   ./bench.sh [ticks]
+# Raw results go to bench.csv, the report to stdout. Every size is a
+# separate build since the sizes are compile time constants.
+# SENSE_GENERATIONS=0 skips the sensing evaluation.
+TICKS=${1:-50}
+SEED=1
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-L/usr/local/lib -I/usr/local/include"}
+LIBS=${LIBS:-"-lSDL2 -lSDL2_image -lrt"}
+BIN=./neatpond_bench
+RESULTS=bench.csv
+
+FISH="10 100 1000 10000"
+FOOD="10 100 1000 10000"
+WORLD="300 3000 30000"
+EYES="2 5 10 20 40"
+THREADS="1 2 4 8"
+SENSING=("" "-sense-every 2" "-sense-every 4" "-sense-every 8" "-sense-every 8 -sense-adaptive")
+SENSE_GENERATIONS=${SENSE_GENERATIONS:-20}
+SENSE_SEEDS=${SENSE_SEEDS:-3}
+
+# the size of every run as key=value pairs, one line each
+: > "$RESULTS"
+
+build() {
+  (cd ./src && $CXX $CXXFLAGS -std=c++14 -O2 -pthread "$@" main.cc -o ../$BIN $LIBS) || exit 1
+}
+
+run() {
+  local sweep=$1
+  shift
+  echo "sweep=$sweep $($BIN -bench $TICKS -seed $SEED "$@")" | tee -a "$RESULTS" >&2
+}
+
+for n in $FISH; do build -DNEATPOND_FISH_AMOUNT=$n; run fish -threads 1; done
+for n in $FOOD; do build -DNEATPOND_FOOD_AMOUNT=$n; run food -threads 1; done
+for n in $WORLD; do build -DNEATPOND_WORLD_SIZE=$n; run world -threads 1; done
+for n in $EYES; do build -DNEATPOND_FISH_NUM_EYES=$n; run eyes -threads 1; done
+build
+for n in $THREADS; do run threads -threads $n; done
+
+# least squares slope of log(phase time) over log(size) for every sweep,
+# a slope above 1.15 means the phase grows faster than the size does
+awk '
+  {
+    for (i = 1; i <= NF; i++) {
+      split($i, pair, "=")
+      value[pair[1]] = pair[2]
+    }
+    sweep = value["sweep"]
+    if (sweep == "threads") {
+      threads[++numThreads] = value["threads"]
+      rate[numThreads] = value["ticks_per_sec"]
+      next
+    }
+    x = log(value[sweep])
+    n[sweep]++
+    sx[sweep] += x
+    sxx[sweep] += x * x
+    numPhases = split("ticks_per_sec move_ms sense_food_ms sense_fish_ms think_ms swim_ms feed_ms reproduce_ms peak_rss_kb", phases, " ")
+    for (p = 1; p <= numPhases; p++) {
+      y = log(value[phases[p]] > 0 ? value[phases[p]] : 1e-9)
+      sy[sweep, phases[p]] += y
+      sxy[sweep, phases[p]] += x * y
+    }
+    printf "%-8s %-8s %12.1f ticks/s %10.3f move ms (%.3f food %.3f fish %.3f think %.3f swim) %10.3f feed ms %10.3f reproduce ms %8d kB\n",
+      sweep, value[sweep], value["ticks_per_sec"], value["move_ms"], value["sense_food_ms"],
+      value["sense_fish_ms"], value["think_ms"], value["swim_ms"], value["feed_ms"],
+      value["reproduce_ms"], value["peak_rss_kb"]
+  }
+  END {
+    print "\nscaling exponents (time ~ size^k)"
+    split("fish food world eyes", sweeps, " ")
+    numPhases = split("sense_food_ms sense_fish_ms think_ms swim_ms feed_ms reproduce_ms peak_rss_kb", phases, " ")
+    for (s = 1; s <= 4; s++) {
+      sweep = sweeps[s]
+      if (n[sweep] < 2) { continue }
+      line = sprintf("%-8s", sweep)
+      for (p = 1; p <= numPhases; p++) {
+        phase = phases[p]
+        covariance = n[sweep] * sxy[sweep, phase] - sx[sweep] * sy[sweep, phase]
+        k = covariance / (n[sweep] * sxx[sweep] - sx[sweep] * sx[sweep])
+        line = line sprintf("  %s %6.2f%s", phase, k, k > 1.15 ? " SUPER-LINEAR" : "")
+      }
+      print line
+    }
+    print "\nthread scaling"
+    for (t = 1; t <= numThreads; t++) {
+      speedup = rate[t] / rate[1]
+      printf "%3d threads %12.1f ticks/s  speedup %5.2f  efficiency %3.0f%%\n",
+        threads[t], rate[t], speedup, 100 * speedup / threads[t]
+    }
+  }
+' "$RESULTS"
+
+# mean fitness over the second half of short runs, averaged over seeds
+fitness() {
+  for seed in $(seq $SENSE_SEEDS); do
+    $BIN -headless -threads 1 -seed $seed -generations $SENSE_GENERATIONS "$@"
+  done | awk -v half=$((SENSE_GENERATIONS / 2)) '
+    /^generation:/ { late = $2 >= half }
+    /^fitness:/ && late { sum += $2; n++ }
+    END { print n ? sum / n : 0 }
+  '
+}
+
+if [ "$SENSE_GENERATIONS" -gt 0 ]; then
+  echo -e "\nsensing schedules ($SENSE_SEEDS seeds, $SENSE_GENERATIONS generations)"
+  for schedule in "${SENSING[@]}"; do
+    speed=$($BIN -bench $TICKS -seed $SEED -threads 1 $schedule | tr ' ' '\n' | grep -E '^(ticks_per_sec|move_ms)=' | tr '\n' ' ')
+    printf "%-32s %s fitness=%s\n" "${schedule:-every tick}" "$speed" "$(fitness $schedule)"
+  done
+fi
+rm -f $BIN
@@ -1,4 +1,4 @@
 #!/bin/bash
 cd ./src &&
-g++ -L/usr/local/lib -I/usr/local/include -std=c++14 -lSDL2 -lSDL2_image main.cc -o ../neatpond &&
+g++ -L/usr/local/lib -I/usr/local/include -std=c++14 -O2 -pthread -lSDL2 -lSDL2_image -lrt main.cc -o ../neatpond &&
 cd ../ && ./neatpond "$@"
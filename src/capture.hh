@@ -0,0 +1,134 @@
+#ifndef capture_h
+#define capture_h
+
+#include "options.hh"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <sys/stat.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct CapturedFrame {
+  int index;
+  int width;
+  int height;
+  // 32 bit ARGB as returned by Renderer::readPixels
+  vector<uint8_t> pixels;
+};
+
+// Encodes captured frames on a background thread. Frames are queued
+// without blocking the simulation; when the encoder falls behind by
+// more than maxQueued frames new ones are dropped and counted instead.
+class FrameWriter {
+private:
+  string directory;
+  int format;
+  size_t maxQueued;
+  ofstream raw;
+
+  thread worker;
+  mutex lock;
+  condition_variable wake;
+  deque<CapturedFrame> queue;
+  bool stopping = false;
+  int dropped = 0;
+
+  void encode(CapturedFrame& frame) {
+    if (format == CAPTURE_RAW) {
+      // packed RGB24, playable with ffmpeg -f rawvideo -pixel_format rgb24
+      vector<uint8_t> rgb(frame.width * frame.height * 3);
+      auto pixels = (const uint32_t*)frame.pixels.data();
+      for (int i = 0; i < frame.width * frame.height; i++) {
+        rgb[i * 3] = pixels[i] >> 16;
+        rgb[i * 3 + 1] = pixels[i] >> 8;
+        rgb[i * 3 + 2] = pixels[i];
+      }
+      raw.write((const char*)rgb.data(), rgb.size());
+      return;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "/frame_%06d.png", frame.index);
+    auto image = SDL_CreateRGBSurfaceWithFormatFrom(
+      frame.pixels.data(), frame.width, frame.height, 32, frame.width * 4,
+      SDL_PIXELFORMAT_ARGB8888
+    );
+    if (image == nullptr || IMG_SavePNG(image, (directory + name).c_str()) != 0) {
+      cerr << "Cannot write frame " << frame.index << ": " << SDL_GetError() << endl;
+    }
+    if (image) { SDL_FreeSurface(image); }
+  }
+
+  void workerLoop() {
+    while (true) {
+      CapturedFrame frame;
+      {
+        unique_lock<mutex> guard(lock);
+        wake.wait(guard, [&] { return stopping || !queue.empty(); });
+        if (queue.empty()) { return; }
+        frame = move(queue.front());
+        queue.pop_front();
+      }
+      encode(frame);
+    }
+  }
+
+public:
+  FrameWriter(const string& directory, int format, int width, int height, float fps, size_t maxQueued = 32):
+    directory(directory),
+    format(format),
+    maxQueued(maxQueued)
+  {
+    mkdir(directory.c_str(), 0755);
+    if (format == CAPTURE_RAW) {
+      raw.open(directory + "/frames.rgb", ios::binary);
+      cout << "Capturing to " << directory << "/frames.rgb, encode with:\n  ffmpeg" <<
+        " -f rawvideo -pixel_format rgb24 -video_size " << width << "x" << height <<
+        " -framerate " << fps << " -i " << directory << "/frames.rgb pond.mp4" << endl;
+    } else {
+      cout << "Capturing to " << directory << ", encode with:\n  ffmpeg" <<
+        " -framerate " << fps << " -i " << directory << "/frame_%06d.png pond.mp4" << endl;
+    }
+    worker = thread(&FrameWriter::workerLoop, this);
+  }
+
+  // finishes the frames still queued
+  ~FrameWriter() {
+    {
+      lock_guard<mutex> guard(lock);
+      stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    if (dropped > 0) {
+      cerr << "Dropped " << dropped << " frames, the encoder could not keep up" << endl;
+    }
+  }
+
+  bool push(CapturedFrame&& frame) {
+    {
+      lock_guard<mutex> guard(lock);
+      if (queue.size() >= maxQueued) {
+        dropped++;
+        return false;
+      }
+      queue.push_back(move(frame));
+    }
+    wake.notify_one();
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef export_h
+#define export_h
+
+#include "genetics.hh"
+#include "network.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Writes a brain as a self-contained C++ header. The network is unrolled
+// into straight-line code with the weights as literals, and it sums in
+// the same order and precision as Network::feedForward so the results
+// match bit for bit. The genome is embedded too, which lets neatpond
+// load the champion back with -champion.
+void exportChampion(const DNA& genes, const Network& brain, const string& path, const string& name) {
+  auto& layers = brain.getLayers();
+  int numLayers = layers.size();
+  int numInputs = layers.front().size() - 1;
+  int numOutputs = layers.back().size() - 1;
+  char literal[32];
+  auto number = [&](double value) {
+    snprintf(literal, sizeof(literal), "%.17g", value);
+    return string(literal);
+  };
+
+  ofstream file(path);
+  if (!file) {
+    cerr << "Cannot write champion " << path << endl;
+    return;
+  }
+
+  file <<
+    "// Evolved by neatpond, generated file.\n"
+    "#ifndef " << name << "_h\n"
+    "#define " << name << "_h\n\n"
+    "#include <cmath>\n\n"
+    "namespace " << name << " {\n\n"
+    "constexpr int NUM_INPUTS = " << numInputs << ";\n"
+    "constexpr int NUM_OUTPUTS = " << numOutputs << ";\n"
+    "constexpr int DNA_LENGTH = " << genes.size() << ";\n\n"
+    "constexpr double GENES[DNA_LENGTH] = {";
+  for (int i = 0; i < genes.size(); i++) {
+    file << (i % 4 == 0 ? "\n  " : " ") << number(genes[i]) << ",";
+  }
+  file << "\n};\n\n"
+    "inline double sigmoid(double x) {\n"
+    "  return 1.f / (1.f + std::exp(-x));\n"
+    "}\n\n"
+    "inline void infer(const double (&input)[NUM_INPUTS], double (&output)[NUM_OUTPUTS]) {\n";
+
+  // outputs of the previous layer, the bias neuron always outputs 1
+  vector<string> previous;
+  for (int n = 0; n < numInputs; n++) {
+    previous.push_back("input[" + to_string(n) + "]");
+  }
+  previous.push_back("1.0");
+
+  for (int l = 1; l < numLayers; l++) {
+    vector<string> current;
+    bool last = l == numLayers - 1;
+    for (int n = 0; n < layers[l].size() - 1; n++) {
+      file << "  float sum_" << l << "_" << n << " = 0.f;\n";
+      for (int p = 0; p < layers[l - 1].size(); p++) {
+        double weight = layers[l - 1][p].getConnectionWeights()[n];
+        file << "  sum_" << l << "_" << n << " += " << previous[p] << " * " << number(weight) << ";\n";
+      }
+      string value = "sigmoid(sum_" + to_string(l) + "_" + to_string(n) + ")";
+      if (last) {
+        file << "  output[" << n << "] = " << value << ";\n";
+      } else {
+        string variable = "layer_" + to_string(l) + "_" + to_string(n);
+        file << "  const double " << variable << " = " << value << ";\n";
+        current.push_back(variable);
+      }
+    }
+    current.push_back("1.0");
+    previous = current;
+  }
+
+  file << "}\n\n}\n\n#endif\n";
+}
+
+// Writes a program that runs an exported champion over a recorded
+// input trace and reports how far it strays from the recorded outputs.
+void exportHarness(const string& path, const string& header, const string& name) {
+  ofstream file(path);
+  if (!file) {
+    cerr << "Cannot write harness " << path << endl;
+    return;
+  }
+  file <<
+    "// Runs " << name << " over a trace written by neatpond -export.\n"
+    "// g++ -O2 -std=c++14 " << path.substr(path.find_last_of('/') + 1) << " && ./a.out < " << name << ".trace\n"
+    "#include \"" << header.substr(header.find_last_of('/') + 1) << "\"\n\n"
+    "#include <cmath>\n"
+    "#include <cstdio>\n"
+    "#include <iostream>\n\n"
+    "int main() {\n"
+    "  double input[" << name << "::NUM_INPUTS];\n"
+    "  double output[" << name << "::NUM_OUTPUTS];\n"
+    "  double expected;\n"
+    "  double maxDeviation = 0.0;\n"
+    "  long rows = 0;\n"
+    "  while (true) {\n"
+    "    for (auto& value : input) {\n"
+    "      if (!(std::cin >> value)) {\n"
+    "        printf(\"rows: %ld\\nmax deviation: %g\\n\", rows, maxDeviation);\n"
+    "        return 0;\n"
+    "      }\n"
+    "    }\n"
+    "    " << name << "::infer(input, output);\n"
+    "    for (auto value : output) {\n"
+    "      std::cin >> expected;\n"
+    "      maxDeviation = fmax(maxDeviation, fabs(value - expected));\n"
+    "    }\n"
+    "    rows++;\n"
+    "  }\n"
+    "}\n";
+}
+
+// Reads the genome back out of a header written by exportChampion.
+bool loadChampion(const string& path, DNA& genes) {
+  ifstream file(path);
+  stringstream contents;
+  contents << file.rdbuf();
+  auto text = contents.str();
+  auto start = text.find("GENES[DNA_LENGTH] = {");
+  auto end = text.find("};", start);
+  if (!file || start == string::npos || end == string::npos) {
+    cerr << "Not a champion header: " << path << endl;
+    return false;
+  }
+  start = text.find('{', start) + 1;
+  stringstream values(text.substr(start, end - start));
+  genes.clear();
+  double gene;
+  char comma;
+  while (values >> gene) {
+    genes.push_back(gene);
+    values >> comma;
+  }
+  return true;
+}
+
+// Keeps the inputs and outputs of the fish that could end up as the
+// champion of a generation: the BRAIN_TRACE_CANDIDATES that collected
+// the most food so far, ties going to the lower index like bestFish().
+// A fish is traced from the tick it last joined them. The champion is
+// one of them on the last tick, and memory stays the same for any
+// number of fish. Every row stands on its own, so a partial trace still
+// checks the harness.
+const int BRAIN_TRACE_CANDIDATES = 8;
+
+class BrainTrace {
+private:
+  map<int, vector<double>> rows;
+  // double precision brains of the candidates with -quantized
+  map<int, Network> networks;
+
+public:
+  void clear() {
+    rows.clear();
+    networks.clear();
+  }
+
+  template<class F>
+  void record(const vector<F>& fishes) {
+    vector<int> candidates(fishes.size());
+    for (int i = 0; i < fishes.size(); i++) { candidates[i] = i; }
+    auto count = min<size_t>(BRAIN_TRACE_CANDIDATES, candidates.size());
+    auto leads = [&](int a, int b) {
+      if (fishes[a].foodCollected != fishes[b].foodCollected) {
+        return fishes[a].foodCollected > fishes[b].foodCollected;
+      }
+      return a < b;
+    };
+    if (count > 0 && count < candidates.size()) {
+      nth_element(candidates.begin(), candidates.begin() + count - 1, candidates.end(), leads);
+    }
+    candidates.resize(count);
+
+    map<int, vector<double>> kept;
+    map<int, Network> keptNetworks;
+    for (auto i : candidates) {
+      auto& values = kept[i];
+      auto found = rows.find(i);
+      if (found != rows.end()) { values.swap(found->second); }
+      auto& fish = fishes[i];
+      if (fish.dead) { continue; }
+      values.insert(values.end(), fish.input.begin(), fish.input.end());
+      if (options.quantizedBits == 0) {
+        values.insert(values.end(), fish.output.begin(), fish.output.end());
+        continue;
+      }
+      // the fish ran a fixed point copy, but the export is the double
+      // precision brain, so trace what that one makes of the input
+      auto network = networks.find(i);
+      auto& exported = keptNetworks[i];
+      exported = network != networks.end() ? move(network->second) : fish.buildNetwork();
+      auto input = fish.input;
+      vector<double> output;
+      exported.feedForward(input);
+      exported.getResults(output);
+      values.insert(values.end(), output.begin(), output.end());
+    }
+    rows.swap(kept);
+    networks.swap(keptNetworks);
+  }
+
+  // false without a trace of fish, and then nothing is written
+  bool write(int fish, int rowSize, const string& path) const {
+    auto found = rows.find(fish);
+    if (found == rows.end()) { return false; }
+    auto& values = found->second;
+    ofstream file(path);
+    if (!file) { return false; }
+    char literal[32];
+    for (int i = 0; i < values.size(); i++) {
+      snprintf(literal, sizeof(literal), "%.17g", values[i]);
+      file << literal << ((i + 1) % rowSize == 0 ? "\n" : " ");
+    }
+    return true;
+  }
+};
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef genetics_h
 #define genetics_h
 
+#include "selection.hh"
+#include "parallel.hh"
+
+#include <memory>
 #include <vector>
 
 using namespace std;
@@ -31,20 +35,20 @@ DNA randomGenes(size_t size) {
   return genes;
 }
 
-DNA crossOver(DNA& genesA, DNA& genesB) {
+DNA crossOver(const DNA& genesA, const DNA& genesB, RandomStream& random) {
   DNA offspringGenes;
-  int midpoint = rand() % genesA.size();
+  int midpoint = random.below(genesA.size());
   for (auto i = 0; i < genesA.size(); i++) {
     offspringGenes.push_back(i > midpoint ? genesA[i] : genesB[i]);
   }
   return offspringGenes;
 }
 
-DNA mutate(DNA genes, float mutationRate) {
+DNA mutate(const DNA& genes, float mutationRate, RandomStream& random) {
   DNA mutatedGenes;
   for (int j = 0; j < genes.size(); j++) {
-    if (mutationRate > RANDOM_NUM) {
-      mutatedGenes.push_back(RANDOM_NUM);
+    if (mutationRate > random.uniform()) {
+      mutatedGenes.push_back(random.uniform());
     } else {
       mutatedGenes.push_back(genes[j]);
     }
@@ -52,13 +56,54 @@ DNA mutate(DNA genes, float mutationRate) {
   return mutatedGenes;
 }
 
-bool sortByFitness(const Genome &genomeA, const Genome &genomeB) {
-  return genomeA.fitnessScore < genomeB.fitnessScore;
+// Constructs count genomes from makeGenes(i) on all workers. The genes
+// may only depend on i, which keeps the result the same for any number
+// of threads.
+template<class T, class F>
+vector<T> buildGenomes(size_t count, F makeGenes) {
+  vector<unique_ptr<T>> built(count);
+  workers().parallelFor(count, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; i++) {
+      built[i].reset(new T(makeGenes(i)));
+    }
+  });
+  vector<T> genomes;
+  genomes.reserve(count);
+  for (auto& genome : built) {
+    genomes.push_back(move(*genome));
+  }
+  return genomes;
 }
 
+// The last capacity values pushed, in no particular order.
+template<class T>
+class SlidingWindow {
+private:
+  vector<T> values;
+  size_t capacity;
+  size_t next = 0;
+
+public:
+  SlidingWindow(size_t capacity): capacity(max<size_t>(1, capacity)) { }
+
+  void push(const T& value) {
+    if (values.size() < capacity) {
+      values.push_back(value);
+    } else {
+      values[next] = value;
+    }
+    next = (next + 1) % capacity;
+  }
+
+  const vector<T>& getValues() const {
+    return values;
+  }
+};
+
 template<class T>
 struct Population {
   vector<T> genomes;
+  Selection selection;
 
   Population(size_t populationSize, size_t dnaSize) {
     for (auto i = populationSize; i--;) {
@@ -71,38 +116,66 @@ struct Population {
     for (auto& genome : genomes) { genome.reset(); }
   }
 
+  // Scoring, selection and breeding all run on the workers. Two draws
+  // from rand() seed the random streams of the whole generation, so a
+  // seeded run breeds the same offspring with any number of threads.
   float reproduce(vector<T>& genomes, float mutationRate) {
     auto numGenomes = genomes.size();
+    vector<float> fitnesses(numGenomes);
+    workers().parallelFor(numGenomes, [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; i++) {
+        fitnesses[i] = genomes[i].calculateFitness();
+      }
+    });
     auto fitnessSum = 0.0f;
-    vector<T> matingPool;
+    for (auto f : fitnesses) { fitnessSum += f; }
+
+    uint64_t selectionSeed = rand();
+    uint64_t breedingSeed = rand();
+    auto numElites = min(selection.elites, numGenomes);
+    auto numOffspring = numGenomes - numElites;
+    auto parents = selectParents(selection, fitnesses, numOffspring * 2, selectionSeed);
+
+    auto offspring = buildGenomes<T>(numOffspring, [&](size_t i) {
+      RandomStream random(breedingSeed, i);
+      return mutate(
+        crossOver(genomes[parents[i * 2]].genes, genomes[parents[i * 2 + 1]].genes, random),
+        mutationRate,
+        random
+      );
+    });
+    offspring.reserve(numGenomes);
 
-    for (auto& g : genomes) {
-      fitnessSum += g.calculateFitness();
+    // elites are moved over as they are, skipping their construction
+    for (auto i : fittestIndices(fitnesses, numElites)) {
+      offspring.push_back(move(genomes[i]));
     }
 
-    sort(genomes.begin(), genomes.end(), sortByFitness);
-
-    while (matingPool.size() == 0) {
-      for (int i = 0; i < genomes.size(); i++) {
-        if (RANDOM_NUM < (i + 1) / (float)numGenomes * 2) {
-          matingPool.push_back(genomes[i]);
-        }
-      }
-    }
+    genomes.swap(offspring);
 
-    genomes.clear();
+    return fitnessSum / (float)numGenomes;
+  }
 
-    for (int i = 0; i < numGenomes; i++) {
-      int a = rand() % matingPool.size();
-      int b = rand() % matingPool.size();
-      auto genes = mutate(
-        crossOver(matingPool[a].genes, matingPool[b].genes),
-        mutationRate
+  // Steady state breeding: replaces the genomes at the indices in
+  // retired with offspring of parents selected among the candidate
+  // genes by their fitnesses.
+  void replace(const vector<int>& retired, const vector<const DNA*>& candidates, const vector<float>& fitnesses, float mutationRate) {
+    if (retired.empty() || candidates.empty()) { return; }
+    uint64_t selectionSeed = rand();
+    uint64_t breedingSeed = rand();
+    auto parents = selectParents(selection, fitnesses, retired.size() * 2, selectionSeed);
+
+    auto offspring = buildGenomes<T>(retired.size(), [&](size_t i) {
+      RandomStream random(breedingSeed, i);
+      return mutate(
+        crossOver(*candidates[parents[i * 2]], *candidates[parents[i * 2 + 1]], random),
+        mutationRate,
+        random
       );
-      genomes.push_back(T(genes));
+    });
+    for (int i = 0; i < retired.size(); i++) {
+      genomes[retired[i]] = move(offspring[i]);
     }
-
-    return fitnessSum / (float)numGenomes;
   }
 };
 
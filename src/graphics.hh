@@ -3,6 +3,8 @@
 
 #include "network.hh"
 #include "pond.hh"
+#include "replay.hh"
+#include "history.hh"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -18,6 +20,7 @@ enum {
 };
 
 const int HUD_HEIGHT = 100;
+const int CHART_BUCKETS = 100;
 
 struct Sprite {
   SDL_Texture* texture;
@@ -68,16 +71,27 @@ void drawNeuron(SDL_Renderer* renderer, Neuron& neuron, int x, int y, int size)
 
 class Renderer {
 private:
-  SDL_Window* window;
-  SDL_Renderer* renderer;
+  SDL_Window* window = nullptr;
+  SDL_Renderer* renderer = nullptr;
+  // render target of offscreen renderers
+  SDL_Surface* surface = nullptr;
   Sprite* sprites[NUM_SPRITE];
   int windowWidth;
   int windowHeight;
 
+  void loadSprites() {
+    sprites[SPRITE_FISH_BODY] = new Sprite(renderer, "res/body.png");
+    sprites[SPRITE_FISH_TAIL] = new Sprite(renderer, "res/tail.png", 1.0, 0.5);
+    sprites[SPRITE_FISH_FIN] = new Sprite(renderer, "res/fin.png");
+    sprites[SPRITE_FOOD] = new Sprite(renderer, "res/food.png");
+    sprites[SPRITE_DEAD] = new Sprite(renderer, "res/dead.png");
+  }
+
 public:
   ~Renderer() {
     SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+    if (window) { SDL_DestroyWindow(window); }
+    if (surface) { SDL_FreeSurface(surface); }
   }
 
   Renderer(const char* title, int w, int h) {
@@ -85,11 +99,43 @@ public:
     SDL_SetWindowTitle(window, title);
     windowWidth = w;
     windowHeight = h;
-    sprites[SPRITE_FISH_BODY] = new Sprite(renderer, "res/body.png");
-    sprites[SPRITE_FISH_TAIL] = new Sprite(renderer, "res/tail.png", 1.0, 0.5);
-    sprites[SPRITE_FISH_FIN] = new Sprite(renderer, "res/fin.png");
-    sprites[SPRITE_FOOD] = new Sprite(renderer, "res/food.png");
-    sprites[SPRITE_DEAD] = new Sprite(renderer, "res/dead.png");
+    loadSprites();
+  }
+
+  // software renderer drawing into memory, works without a display
+  Renderer(int w, int h) {
+    surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    assert(surface != nullptr);
+    renderer = SDL_CreateSoftwareRenderer(surface);
+    assert(renderer != nullptr);
+    windowWidth = w;
+    windowHeight = h;
+    loadSprites();
+  }
+
+  int width() const {
+    return windowWidth;
+  }
+
+  int height() const {
+    return windowHeight;
+  }
+
+  // copies the rendered image out as 32 bit ARGB pixels
+  void readPixels(vector<uint8_t>& pixels) {
+    pixels.resize(windowWidth * windowHeight * 4);
+    SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_ARGB8888, pixels.data(), windowWidth * 4);
+  }
+
+  // draws the whole world scaled down to fit the target
+  void fitWorld() {
+    float s = fmin(windowWidth, windowHeight) / float(WORLD_SIZE);
+    SDL_RenderSetViewport(renderer, nullptr);
+    SDL_RenderSetScale(renderer, s, s);
+  }
+
+  void resetScale() {
+    SDL_RenderSetScale(renderer, 1, 1);
   }
 
   void resize(int w, int h) {
@@ -131,6 +177,23 @@ public:
     SDL_RenderPresent(renderer);
   }
 
+  void drawChunks() {
+    int chunkSize = GRID_SIZE;
+    for (int x = 0; x < WORLD_CHUNKS; x++) {
+      for (int y = 0; y < WORLD_CHUNKS; y++) {
+        if ((x + y) % 2 == 0) {
+          color(3, 5, 25);
+          rect(
+            x * chunkSize,
+            y * chunkSize,
+            chunkSize,
+            chunkSize
+          );
+        }
+      }
+    }
+  }
+
   void drawPond(const NeatPond& pond, int selectedFish = -1) {
     auto& fishes = pond.getFishes();
     auto& foods = pond.getFood();
@@ -139,6 +202,10 @@ public:
       drawFish(fishes[i], i == selectedFish);
     }
 
+    for (auto& champion : pond.getChampions()) {
+      drawFish(champion, false);
+    }
+
     for (auto& food : foods) {
       if (selectedFish == -1 || fishes[selectedFish].canSeeFood(food)) {
         drawSprite(SPRITE_FOOD, food.position.x, food.position.y);
@@ -153,9 +220,6 @@ public:
     int b = genes[TRAIT_BLUE] * 255;
     float x = fish.position.x;
     float y = fish.position.y;
-    float tailAngle = sin((float)0.0 / 2) * 0.25;
-    float bodyAngle = sin((float)0.0 / 10) * 0.2;
-
     if (drawSensors) {
       for (int i = 0; i < FISH_NUM_EYES; i++) {
         float strength = fish.input[i];
@@ -169,29 +233,40 @@ public:
       }
     }
 
-    if (!fish.dead) {
-      drawSprite(SPRITE_FISH_TAIL, x - cos(fish.angle) * 12, y - sin(fish.angle) * 12, fish.angle + tailAngle, r, g, b);
-      drawSprite(SPRITE_FISH_BODY, x, y, fish.angle);
-      drawSprite(SPRITE_FISH_FIN, x, y, fish.angle, r, g, b);
+    drawFishSprite(x, y, fish.angle, r, g, b, fish.dead);
+  }
+
+  void drawFishSprite(float x, float y, float angle, int r, int g, int b, bool dead) {
+    if (!dead) {
+      drawSprite(SPRITE_FISH_TAIL, x - cos(angle) * 12, y - sin(angle) * 12, angle, r, g, b);
+      drawSprite(SPRITE_FISH_BODY, x, y, angle);
+      drawSprite(SPRITE_FISH_FIN, x, y, angle, r, g, b);
     } else {
       drawSprite(SPRITE_DEAD, x, y);
     }
   }
 
-  void drawChart(
-    const vector<float>& averageFitnesses,
-    const vector<array<float, 3>>& averageColors,
-    float maxFitness
-  ) {
-    assert(averageFitnesses.size() == averageColors.size());
+  void drawReplay(const ReplayFrame& frame, const vector<array<uint8_t, 3>>& colors) {
+    for (int i = frame.fishes.size(); i--;) {
+      auto& fish = frame.fishes[i];
+      auto& color = colors[i];
+      drawFishSprite(fish.position.x, fish.position.y, fish.angle, color[0], color[1], color[2], fish.dead);
+    }
+
+    for (auto& food : frame.foods) {
+      drawSprite(SPRITE_FOOD, food.x, food.y);
+    }
+  }
 
+  void drawChart(const vector<HistoryBucket>& buckets, float maxFitness) {
     int chartWidth = windowWidth / 2;
     int chartHeight = HUD_HEIGHT;
     int chartTop = windowHeight - HUD_HEIGHT;
     int chartMargin = 8;
-    int dataChunkSize = 100;
+    int dataChunkSize = CHART_BUCKETS;
     int barMargin = chartMargin + 2;
     float barWidth = float(chartWidth - barMargin * 2) / float(dataChunkSize);
+    float scale = maxFitness > 0 ? maxFitness : 1;
     SDL_Rect chart = {
       chartMargin,
       chartTop + chartMargin,
@@ -202,17 +277,14 @@ public:
     SDL_SetRenderDrawColor(renderer, 255, 250, 244, 255);
     SDL_RenderFillRect(renderer, &chart);
 
-    int offset = max(0, int(averageFitnesses.size() - dataChunkSize));
-    int length = min(dataChunkSize, int(averageFitnesses.size()));
+    int length = min(dataChunkSize, int(buckets.size()));
 
     for (int i = 0; i < length; i++) {
-      auto fitness = averageFitnesses[offset + i];
-      auto color = averageColors[offset + i];
-      float value = fitness / (maxFitness > 0 ? maxFitness : 1);
-      int barHeight = chartHeight * value;
-      int r = color[0] * 255;
-      int g = color[1] * 255;
-      int b = color[2] * 255;
+      auto& bucket = buckets[i];
+      int barHeight = chartHeight * (bucket.mean / scale);
+      int r = bucket.color[0] * 255;
+      int g = bucket.color[1] * 255;
+      int b = bucket.color[2] * 255;
       SDL_Rect bar;
       bar.x = float(barWidth * float(i) + float(barMargin));
       bar.y = chartTop + chartHeight - barHeight + barMargin;
@@ -220,6 +292,16 @@ public:
       bar.h = max(0, barHeight - barMargin * 2);
       SDL_SetRenderDrawColor(renderer, r, g, b, 255);
       SDL_RenderFillRect(renderer, &bar);
+
+      // spread of the generations merged into this bar
+      if (bucket.count > 1) {
+        int x = bar.x + bar.w / 2;
+        int top = chartTop + chartHeight + barMargin - chartHeight * (bucket.max / scale);
+        int bottom = chartTop + chartHeight + barMargin - chartHeight * (bucket.min / scale);
+        int floor = chartTop + chartHeight - barMargin;
+        SDL_SetRenderDrawColor(renderer, r / 2, g / 2, b / 2, 255);
+        SDL_RenderDrawLine(renderer, x, min(floor, top), x, min(floor, bottom));
+      }
     }
   }
 
@@ -0,0 +1,132 @@
+#ifndef history_h
+#define history_h
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <vector>
+
+using namespace std;
+
+// Summary of the average fitness over a run of generations.
+struct HistoryBucket {
+  int first = 0;
+  int count = 0;
+  float min = 0.f;
+  float mean = 0.f;
+  float max = 0.f;
+  array<float, 3> color = {{0.f, 0.f, 0.f}};
+
+  int end() const {
+    return first + count;
+  }
+
+  void merge(const HistoryBucket& other) {
+    if (count == 0) {
+      *this = other;
+      return;
+    }
+    float total = count + other.count;
+    float weight = other.count / total;
+    first = std::min(first, other.first);
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    mean += (other.mean - mean) * weight;
+    for (int c = 0; c < 3; c++) {
+      color[c] += (other.color[c] - color[c]) * weight;
+    }
+    count = total;
+  }
+};
+
+// Fitness per generation in fixed memory. Level 0 keeps the most recent
+// generations one by one; whenever a level is full its two oldest
+// buckets are merged and handed to the next level, so every level
+// holds buckets twice as wide as the one before. The last level merges
+// in place, which keeps the whole run no matter how long it gets.
+class FitnessHistory {
+private:
+  vector<deque<HistoryBucket>> levels;
+  size_t capacity;
+  int total = 0;
+
+  void pushBucket(int level, const HistoryBucket& bucket) {
+    auto& buckets = levels[level];
+    buckets.push_back(bucket);
+    if (buckets.size() <= capacity) { return; }
+
+    HistoryBucket oldest = buckets.front();
+    buckets.pop_front();
+    oldest.merge(buckets.front());
+    buckets.pop_front();
+
+    if (level + 1 < levels.size()) {
+      pushBucket(level + 1, oldest);
+    } else {
+      buckets.push_front(oldest);
+    }
+  }
+
+public:
+  FitnessHistory(size_t capacity = 256, int numLevels = 24):
+    levels(max(1, numLevels)),
+    capacity(max<size_t>(2, capacity)) { }
+
+  void push(float fitness, const array<float, 3>& color) {
+    HistoryBucket bucket;
+    bucket.first = total++;
+    bucket.count = 1;
+    bucket.min = bucket.mean = bucket.max = fitness;
+    bucket.color = color;
+    pushBucket(0, bucket);
+  }
+
+  // number of generations recorded
+  int size() const {
+    return total;
+  }
+
+  // generations [from, to) summarized into at most numBuckets buckets,
+  // the cost only depends on numBuckets and the number of levels
+  vector<HistoryBucket> query(int from, int to, int numBuckets) const {
+    from = max(0, from);
+    to = min(total, to);
+    vector<HistoryBucket> bins;
+    if (from >= to || numBuckets <= 0) { return bins; }
+
+    int span = to - from;
+    numBuckets = min(numBuckets, span);
+    bins.resize(numBuckets);
+
+    // oldest data lives in the highest level
+    for (int l = levels.size(); l--;) {
+      auto& buckets = levels[l];
+      auto it = upper_bound(buckets.begin(), buckets.end(), from, [](int value, const HistoryBucket& b) {
+        return value < b.end();
+      });
+      for (; it != buckets.end() && it->first < to; ++it) {
+        int begin = max(from, it->first) - from;
+        int end = min(to, it->end()) - from - 1;
+        int firstBin = (long(begin) * numBuckets) / span;
+        int lastBin = (long(end) * numBuckets) / span;
+        for (int b = firstBin; b <= lastBin; b++) {
+          bins[b].merge(*it);
+        }
+      }
+    }
+
+    bins.erase(
+      remove_if(bins.begin(), bins.end(), [](const HistoryBucket& b) { return b.count == 0; }),
+      bins.end()
+    );
+    return bins;
+  }
+
+  // the last numGenerations generations, the whole run when 0
+  vector<HistoryBucket> recent(int numGenerations, int numBuckets) const {
+    int from = numGenerations > 0 ? total - numGenerations : 0;
+    return query(from, total, numBuckets);
+  }
+};
+
+#endif
@@ -0,0 +1,368 @@
+#ifndef live_h
+#define live_h
+
+#include "pond.hh"
+#include "replay.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// A headless run publishes snapshots of its pond into POSIX shared
+// memory for a GUI to watch. The snapshots go round a ring of slots,
+// each guarded by a sequence number that is odd while the slot is being
+// written (a seqlock). The publisher never waits: a reader that sees
+// the sequence odd or changed under it drops the copy and tries again
+// on its next frame, and by then the publisher has moved to the next
+// slot. Both sides must be built with the same pond sizes.
+const char LIVE_MAGIC[4] = { 'N', 'P', 'L', 'V' };
+const uint32_t LIVE_VERSION = 2;
+const int LIVE_SLOTS = 4;
+// fitness of the last generations, enough to fill the chart
+const int LIVE_HISTORY = 64;
+// every generation spawns 1 + RANDOM_NUM * 4 food per FOOD_AMOUNT, 5
+// when rand() hits RAND_MAX, and regrowth only adds to chunks below
+// MAX_FOOD_PER_CHUNK, so no pond holds more
+const int LIVE_MAX_FOOD = 5 * FOOD_AMOUNT + WORLD_CHUNKS * WORLD_CHUNKS * MAX_FOOD_PER_CHUNK;
+
+struct LiveFish {
+  float x;
+  float y;
+  float angle;
+  uint8_t color[3];
+  uint8_t dead;
+};
+
+struct LiveFood {
+  float x;
+  float y;
+};
+
+struct LiveFitness {
+  int32_t generation;
+  float fitness;
+  float color[3];
+};
+
+// one snapshot, followed in its slot by the fishes and then the foods
+struct LiveSnapshot {
+  int32_t generation;
+  int32_t tick;
+  int32_t numFishes;
+  int32_t numFoods;
+  // the fish whose brain is shown, -1 for none
+  int32_t selected;
+  double genes[DNA_LENGTH];
+  double input[NUM_INPUTS];
+  // what its brain made of the input, and the bits of its weights, 0
+  // for double precision
+  double output[NUM_OUTPUTS];
+  int32_t quantizedBits;
+  int32_t numHistory;
+  LiveFitness history[LIVE_HISTORY];
+};
+
+struct LiveSlot {
+  atomic<uint64_t> sequence;
+  LiveSnapshot snapshot;
+};
+
+struct LiveHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t slotSize;
+  uint32_t fishCapacity;
+  uint32_t foodCapacity;
+  uint32_t dnaLength;
+  // number of snapshots published, the latest is in slot (published - 1) % LIVE_SLOTS
+  atomic<uint64_t> published;
+};
+
+// shm_open wants names like /neatpond
+string liveName(const string& name) {
+  return name.empty() || name[0] == '/' ? name : "/" + name;
+}
+
+// the name of the open publisher, unlinked if the run is interrupted
+char liveOpenName[256] = "";
+
+void unlinkLive(int number) {
+  if (liveOpenName[0]) {
+    shm_unlink(liveOpenName);
+  }
+  signal(number, SIG_DFL);
+  raise(number);
+}
+
+size_t liveSlotSize(size_t fishCapacity) {
+  size_t size = sizeof(LiveSlot) + fishCapacity * sizeof(LiveFish) + LIVE_MAX_FOOD * sizeof(LiveFood);
+  return (size + 63) / 64 * 64;
+}
+
+class LivePublisher {
+private:
+  string name;
+  uint8_t* memory = nullptr;
+  size_t size = 0;
+  LiveHeader* header = nullptr;
+  size_t slotSize = 0;
+  size_t fishCapacity = 0;
+  vector<LiveFitness> history;
+
+  LiveSlot& slot(uint64_t index) {
+    return *(LiveSlot*)(memory + sizeof(LiveHeader) + slotSize * (index % LIVE_SLOTS));
+  }
+
+public:
+  LivePublisher(const string& path, size_t fishCapacity):
+    name(liveName(path)),
+    fishCapacity(fishCapacity)
+  {
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+      cerr << "Cannot open shared memory " << name << endl;
+      return;
+    }
+    slotSize = liveSlotSize(fishCapacity);
+    size = sizeof(LiveHeader) + slotSize * LIVE_SLOTS;
+    if (ftruncate(fd, size) != 0) {
+      cerr << "Cannot size shared memory " << name << endl;
+      close(fd);
+      return;
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+      cerr << "Cannot map shared memory " << name << endl;
+      return;
+    }
+    memory = (uint8_t*)mapped;
+    memset(memory, 0, size);
+
+    header = new (memory) LiveHeader();
+    header->version = LIVE_VERSION;
+    header->slotSize = slotSize;
+    header->fishCapacity = fishCapacity;
+    header->foodCapacity = LIVE_MAX_FOOD;
+    header->dnaLength = DNA_LENGTH;
+    header->published.store(0);
+    for (int i = 0; i < LIVE_SLOTS; i++) {
+      new (&slot(i).sequence) atomic<uint64_t>(0);
+    }
+    // readers check the magic last
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, LIVE_MAGIC, 4);
+
+    if (name.size() < sizeof(liveOpenName)) {
+      strcpy(liveOpenName, name.c_str());
+      signal(SIGINT, unlinkLive);
+      signal(SIGTERM, unlinkLive);
+    }
+  }
+
+  ~LivePublisher() {
+    if (!memory) { return; }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    liveOpenName[0] = 0;
+    munmap(memory, size);
+    shm_unlink(name.c_str());
+  }
+
+  bool isOpen() const {
+    return memory != nullptr;
+  }
+
+  // call once per generation with the fitness pond.reset() returned
+  void pushFitness(int generation, float fitness, const array<float, 3>& color) {
+    history.push_back({ generation, fitness, { color[0], color[1], color[2] } });
+    if (history.size() > LIVE_HISTORY) {
+      history.erase(history.begin());
+    }
+  }
+
+  // copies the pond into the next slot, showing the brain of selected
+  void publish(const NeatPond& pond, int generation, int tick, int selected) {
+    if (!memory) { return; }
+    auto& fishes = pond.getFishes();
+    auto& champions = pond.getChampions();
+
+    auto index = header->published.load(memory_order_relaxed);
+    auto& target = slot(index);
+    auto sequence = target.sequence.load(memory_order_relaxed);
+    target.sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    auto& snapshot = target.snapshot;
+    snapshot.tick = tick;
+    snapshot.generation = generation;
+    snapshot.selected = selected >= 0 && selected < fishes.size() ? selected : -1;
+    if (snapshot.selected >= 0) {
+      auto& fish = fishes[selected];
+      copy(fish.genes.begin(), fish.genes.end(), snapshot.genes);
+      copy(fish.input.begin(), fish.input.end(), snapshot.input);
+      copy(fish.output.begin(), fish.output.end(), snapshot.output);
+    }
+    snapshot.quantizedBits = options.quantizedBits;
+
+    auto liveFishes = (LiveFish*)(&target + 1);
+    int numFishes = 0;
+    auto addFish = [&](const Fish& fish) {
+      if (numFishes >= fishCapacity) { return; }
+      liveFishes[numFishes++] = {
+        fish.position.x, fish.position.y, fish.angle,
+        {
+          uint8_t(fish.genes[TRAIT_RED] * 255),
+          uint8_t(fish.genes[TRAIT_GREEN] * 255),
+          uint8_t(fish.genes[TRAIT_BLUE] * 255)
+        },
+        fish.dead
+      };
+    };
+    for (auto& fish : fishes) { addFish(fish); }
+    for (auto& champion : champions) { addFish(champion); }
+    snapshot.numFishes = numFishes;
+
+    auto liveFoods = (LiveFood*)(liveFishes + fishCapacity);
+    int numFoods = 0;
+    pond.forFood([&](const Food& food) {
+      if (numFoods < LIVE_MAX_FOOD) {
+        liveFoods[numFoods++] = { food.position.x, food.position.y };
+      }
+    });
+    snapshot.numFoods = numFoods;
+
+    snapshot.numHistory = history.size();
+    copy(history.begin(), history.end(), snapshot.history);
+
+    target.sequence.store(sequence + 2, memory_order_release);
+    header->published.store(index + 1, memory_order_release);
+  }
+};
+
+// Attaches to a publisher read only. read() copies the latest complete
+// snapshot into a replay frame, so the GUI draws it like a replay.
+class LiveViewer {
+private:
+  string name;
+  const uint8_t* memory = nullptr;
+  size_t size = 0;
+  const LiveHeader* header = nullptr;
+  uint64_t lastPublished = 0;
+
+  const LiveSlot& slot(uint64_t index) const {
+    return *(const LiveSlot*)(memory + sizeof(LiveHeader) + header->slotSize * (index % LIVE_SLOTS));
+  }
+
+public:
+  ReplayFrame frame;
+  vector<array<uint8_t, 3>> colors;
+  LiveSnapshot snapshot;
+
+  LiveViewer(const string& path): name(liveName(path)) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      cerr << "Nothing published as " << name << endl;
+      return;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < sizeof(LiveHeader)) {
+      cerr << "Shared memory " << name << " is not ready" << endl;
+      close(fd);
+      return;
+    }
+    size = status.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+      cerr << "Cannot map shared memory " << name << endl;
+      return;
+    }
+    memory = (const uint8_t*)mapped;
+    header = (const LiveHeader*)memory;
+
+    bool matches =
+      memcmp(header->magic, LIVE_MAGIC, 4) == 0 &&
+      header->version == LIVE_VERSION &&
+      header->foodCapacity == LIVE_MAX_FOOD &&
+      header->dnaLength == DNA_LENGTH &&
+      header->slotSize == liveSlotSize(header->fishCapacity) &&
+      size >= sizeof(LiveHeader) + header->slotSize * LIVE_SLOTS;
+    atomic_thread_fence(memory_order_acquire);
+    if (!matches) {
+      cerr << "Shared memory " << name << " is not ready or was published by a different build" << endl;
+      munmap((void*)memory, size);
+      memory = nullptr;
+    }
+    snapshot.generation = 0;
+    snapshot.selected = -1;
+    snapshot.quantizedBits = 0;
+    snapshot.numHistory = 0;
+  }
+
+  ~LiveViewer() {
+    if (memory) {
+      munmap((void*)memory, size);
+    }
+  }
+
+  bool isOpen() const {
+    return memory != nullptr;
+  }
+
+  // true when a snapshot newer than the last one was copied
+  bool read() {
+    if (!memory) { return false; }
+    auto published = header->published.load(memory_order_acquire);
+    if (published == 0 || published == lastPublished) { return false; }
+
+    auto& source = slot(published - 1);
+    auto sequence = source.sequence.load(memory_order_acquire);
+    if (sequence & 1) { return false; }
+
+    auto& copied = source.snapshot;
+    LiveSnapshot next;
+    memcpy(&next, &copied, sizeof(LiveSnapshot));
+    int numFishes = max(0, min<int>(next.numFishes, header->fishCapacity));
+    int numFoods = max(0, min<int>(next.numFoods, LIVE_MAX_FOOD));
+    vector<LiveFish> fishes(numFishes);
+    vector<LiveFood> foods(numFoods);
+    auto liveFishes = (const LiveFish*)(&source + 1);
+    auto liveFoods = (const LiveFood*)(liveFishes + header->fishCapacity);
+    memcpy(fishes.data(), liveFishes, numFishes * sizeof(LiveFish));
+    memcpy(foods.data(), liveFoods, numFoods * sizeof(LiveFood));
+
+    // the publisher wrote over the slot while it was copied
+    atomic_thread_fence(memory_order_acquire);
+    if (source.sequence.load(memory_order_relaxed) != sequence) { return false; }
+
+    snapshot = next;
+    frame.fishes.clear();
+    colors.clear();
+    for (auto& fish : fishes) {
+      frame.fishes.push_back({ Vector2D(fish.x, fish.y), fish.angle, fish.dead != 0 });
+      colors.push_back({ fish.color[0], fish.color[1], fish.color[2] });
+    }
+    frame.foods.clear();
+    for (auto& food : foods) {
+      frame.foods.push_back(Vector2D(food.x, food.y));
+    }
+    lastPublished = published;
+    return true;
+  }
+};
+
+#endif
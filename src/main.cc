@@ -3,8 +3,16 @@
 #include "genetics.hh"
 #include "graphics.hh"
 #include "pond.hh"
+#include "vecpond.hh"
+#include "options.hh"
+#include "replay.hh"
+#include "capture.hh"
+#include "verify.hh"
+#include "live.hh"
 
 #include <SDL2/SDL.h>
+#include <sys/resource.h>
+#include <chrono>
 
 using namespace std;
 
@@ -12,43 +20,468 @@ const char* WINDOW_TITLE = "✿◡ neatpond ◡✿";
 int windowWidth = 960;
 int windowHeight = 720;
 
+array<float, 3> averageColor(const vector<Fish>& fishes) {
+  float r = 0.0;
+  float g = 0.0;
+  float b = 0.0;
+
+  for (auto& genome : fishes) {
+    r += genome.genes[TRAIT_RED];
+    g += genome.genes[TRAIT_GREEN];
+    b += genome.genes[TRAIT_BLUE];
+  }
+
+  float numFishes = fmax(1, fishes.size());
+  return {r / numFishes, g / numFishes, b / numFishes};
+}
+
+int bestFish(const vector<Fish>& fishes) {
+  int best = -1;
+  for (int i = 0; i < fishes.size(); i++) {
+    if (best < 0 || fishes[i].foodCollected > fishes[best].foodCollected) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// writes the best brain of generation g as a header, a harness that
+// runs it and the inputs and outputs it saw since it led the generation
+void exportBest(const NeatPond& pond, const BrainTrace& trace, int g) {
+  auto& fishes = pond.getFishes();
+  int best = bestFish(fishes);
+  if (best < 0) { return; }
+
+  mkdir(options.exportPath.c_str(), 0755);
+  string name = "champion_" + to_string(g);
+  string base = options.exportPath + "/" + name;
+  exportChampion(fishes[best].genes, fishes[best].buildNetwork(), base + ".hh", name);
+  exportHarness(base + ".cc", base + ".hh", name);
+  if (!trace.write(best, NUM_INPUTS + NUM_OUTPUTS, base + ".trace")) {
+    cerr << "No trace of the champion of generation " << g << endl;
+  }
+}
+
+// renders the whole pond with the best brain and the fitness chart
+void drawCapture(
+  Renderer& renderer,
+  const NeatPond& pond,
+  const FitnessHistory& history,
+  float maxFitness
+) {
+  auto& fishes = pond.getFishes();
+  int best = bestFish(fishes);
+
+  renderer.resetScale();
+  renderer.translate(0, 0);
+  renderer.color(0, 0, 0);
+  renderer.clear();
+
+  renderer.fitWorld();
+  renderer.drawChunks();
+  renderer.drawPond(pond);
+
+  renderer.resetScale();
+  renderer.translate(0, 0);
+  if (best >= 0) {
+    renderer.drawNetwork(fishes[best].activeNetwork());
+  }
+  renderer.drawChart(history.recent(0, CHART_BUCKETS), maxFitness);
+}
+
 void runHeadless() {
   int t = 0;
   int g = 0;
 
   NeatPond pond;
+  ReplayRecorder recorder(options.recordPath, options.recordEvery, options.recordFish);
+  BrainTrace trace;
+  bool exporting = !options.exportPath.empty();
 
-  while (true) {
+  unique_ptr<LivePublisher> publisher;
+  if (!options.publishPath.empty()) {
+    publisher.reset(new LivePublisher(options.publishPath, FISH_AMOUNT + pond.getChampions().size()));
+  }
+
+  unique_ptr<Renderer> offscreen;
+  unique_ptr<FrameWriter> frameWriter;
+  int numFrames = 0;
+  float maxFitness = 0.0;
+  FitnessHistory history;
+
+  if (!options.capturePath.empty()) {
+    SDL_Init(0);
+    IMG_Init(IMG_INIT_PNG);
+    offscreen.reset(new Renderer(options.captureWidth, options.captureHeight));
+    frameWriter.reset(new FrameWriter(
+      options.capturePath, options.captureFormat,
+      options.captureWidth, options.captureHeight, options.captureFps
+    ));
+  }
+
+  while (options.generations == 0 || g < options.generations) {
     pond.update();
+    recorder.recordTick(pond, g);
+    if (publisher && t % options.publishEvery == 0) {
+      publisher->publish(pond, g, t, bestFish(pond.getFishes()));
+    }
+    if (exporting && g % options.exportEvery == 0) {
+      trace.record(pond.getFishes());
+    }
+
+    if (frameWriter && g % options.captureEvery == 0 && t % options.captureTicks == 0) {
+      drawCapture(*offscreen, pond, history, maxFitness);
+      CapturedFrame frame { numFrames++, offscreen->width(), offscreen->height(), {} };
+      offscreen->readPixels(frame.pixels);
+      frameWriter->push(move(frame));
+    }
+
     if (++t > GENERATION_LIFESPAN) {
+      recorder.endGeneration();
+      if (exporting && g % options.exportEvery == 0) {
+        exportBest(pond, trace, g);
+        trace.clear();
+      }
+      auto reproduceStart = chrono::steady_clock::now();
       float f = pond.reset();
+      chrono::duration<double, milli> reproduceTime = chrono::steady_clock::now() - reproduceStart;
       cout << "generation: " << g << endl;
       cout << "fitness: " << f << endl;
+      cout << "reproduce ms: " << reproduceTime.count() << endl;
+      if (!pond.getChampions().empty()) {
+        cout << "champion fitness: " << pond.getChampionFitness() << endl;
+      }
+
+      if (frameWriter) {
+        maxFitness = fmax(maxFitness, f);
+        history.push(f, averageColor(pond.getFishes()));
+      }
+      if (publisher) {
+        publisher->pushFitness(g, f, averageColor(pond.getFishes()));
+      }
+
       t = 0;
       g++;
     }
   }
 }
 
+void runVectorized() {
+  VecPond ponds(options.environments);
+  // only the first pond is recorded
+  ReplayRecorder recorder(options.recordPath, options.recordEvery, options.recordFish);
+  long fishSteps = 0;
+  auto timeStart = chrono::steady_clock::now();
+
+  // the ponds advance in lockstep, so they all reach the last together
+  while (options.generations == 0 || ponds.getGeneration(0) < options.generations) {
+    fishSteps += ponds.numFishes();
+    // the tick is recorded before a reset starts the next generation
+    ponds.update([&](int e) {
+      if (e == 0) {
+        recorder.recordTick(ponds.getPond(0), ponds.getGeneration(0));
+      }
+    }, [&](int e, float fitness) {
+      cout << "environment: " << e << endl;
+      cout << "generation: " << ponds.getGeneration(e) << endl;
+      cout << "fitness: " << fitness << endl;
+      cout << "reproduce ms: " << ponds.getReproduceTime(e) << endl;
+
+      if (e == ponds.size() - 1) {
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - timeStart;
+        cout << "fish-steps/sec: " << fishSteps / elapsed.count() << endl;
+      }
+    });
+  }
+}
+
+// compares the quantized brains against the double precision network
+// on random genomes and inputs. The three are timed on their own, each
+// writing its outputs, and compared afterwards.
+void runQuantizedReport() {
+  const int numGenomes = 1000;
+  const int numSamples = 200;
+  vector<Network> networks;
+  vector<QuantizedNetwork> brains16;
+  vector<QuantizedNetwork> brains8;
+  vector<vector<double>> inputs;
+
+  for (int i = 0; i < numGenomes; i++) {
+    networks.push_back(Fish(randomGenes(DNA_LENGTH)).buildNetwork());
+    brains16.push_back(QuantizedNetwork(networks.back(), 16));
+    brains8.push_back(QuantizedNetwork(networks.back(), 8));
+  }
+  for (int s = 0; s < numSamples; s++) {
+    inputs.push_back(vector<double>());
+    for (int i = 0; i < NUM_INPUTS; i++) {
+      inputs.back().push_back(RANDOM_NUM);
+    }
+  }
+
+  // results[mode][g * numSamples + s], mode 0 is double, 1 int16, 2 int8
+  vector<vector<double>> results[3];
+  double seconds[3];
+  for (int mode = 0; mode < 3; mode++) {
+    results[mode].assign(numGenomes * numSamples, vector<double>(NUM_OUTPUTS));
+    auto start = chrono::steady_clock::now();
+    for (int g = 0; g < numGenomes; g++) {
+      for (int s = 0; s < numSamples; s++) {
+        auto& result = results[mode][g * numSamples + s];
+        if (mode == 0) {
+          networks[g].feedForward(inputs[s]);
+          networks[g].getResults(result);
+        } else if (mode == 1) {
+          brains16[g].feedForward(inputs[s], result);
+        } else {
+          brains8[g].feedForward(inputs[s], result);
+        }
+      }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    seconds[mode] = elapsed.count();
+  }
+
+  double maxDeviation[3] = {0.0, 0.0, 0.0};
+  double sumDeviation[3] = {0.0, 0.0, 0.0};
+  for (int mode = 1; mode < 3; mode++) {
+    for (int r = 0; r < results[0].size(); r++) {
+      for (int o = 0; o < NUM_OUTPUTS; o++) {
+        double deviation = fabs(results[mode][r][o] - results[0][r][o]);
+        maxDeviation[mode] = fmax(maxDeviation[mode], deviation);
+        sumDeviation[mode] += deviation;
+      }
+    }
+  }
+
+  double numOutputs = double(numGenomes) * numSamples * NUM_OUTPUTS;
+  double inferences = double(numGenomes) * numSamples;
+  cout <<
+    "genomes: " << numGenomes << ", inputs per genome: " << numSamples <<
+    "\ndouble: " << weightBytes(networks[0]) << " weight bytes, " <<
+      inferences / seconds[0] << " inferences/sec" <<
+    "\nint16: " << brains16[0].weightBytes() << " weight bytes, " <<
+      inferences / seconds[1] << " inferences/sec" <<
+      ", max deviation " << maxDeviation[1] << ", mean deviation " << sumDeviation[1] / numOutputs <<
+    "\nint8: " << brains8[0].weightBytes() << " weight bytes, " <<
+      inferences / seconds[2] << " inferences/sec" <<
+      ", max deviation " << maxDeviation[2] << ", mean deviation " << sumDeviation[2] / numOutputs <<
+  endl;
+}
+
+// times the phases of a tick and one reproduction, and prints them on
+// a single line of key=value pairs for bench.sh to collect
+void runBenchmark() {
+  using Clock = chrono::steady_clock;
+  auto milliseconds = [](Clock::duration duration) {
+    return chrono::duration<double, milli>(duration).count();
+  };
+
+  NeatPond pond;
+  // the stages of NeatPond::moveFish, each run over all fishes in turn
+  enum { SENSE_FOOD, SENSE_FISH, THINK, SWIM, NUM_STAGES };
+  const char* stageNames[NUM_STAGES] = { "sense_food_ms", "sense_fish_ms", "think_ms", "swim_ms" };
+  array<Clock::duration, NUM_STAGES> stages;
+  stages.fill(Clock::duration(0));
+  Clock::duration feeding(0);
+  long awakeChunks = 0;
+  auto start = Clock::now();
+  for (int t = 0; t < options.benchTicks; t++) {
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+      auto stageStart = Clock::now();
+      // the same split of the work as NeatPond::update
+      pond.forFishes([&](int i) {
+        switch (stage) {
+          case SENSE_FOOD: pond.senseFood(i); break;
+          case SENSE_FISH: pond.senseFish(i); break;
+          case THINK: pond.think(i); break;
+          default: pond.swim(i);
+        }
+      });
+      stages[stage] += Clock::now() - stageStart;
+    }
+    auto fed = Clock::now();
+    pond.feed();
+    feeding += Clock::now() - fed;
+    awakeChunks += pond.numAwakeChunks();
+  }
+  Clock::duration moving(0);
+  for (auto& stage : stages) { moving += stage; }
+  double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+  auto reproduceStart = Clock::now();
+  pond.reset();
+  auto reproducing = Clock::now() - reproduceStart;
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  cout <<
+    "fish=" << FISH_AMOUNT <<
+    " food=" << FOOD_AMOUNT <<
+    " world=" << WORLD_SIZE <<
+    " eyes=" << FISH_NUM_EYES <<
+    " threads=" << workers().size() <<
+    " ticks=" << options.benchTicks <<
+    " ticks_per_sec=" << options.benchTicks / seconds <<
+    " move_ms=" << milliseconds(moving) / options.benchTicks;
+  for (int stage = 0; stage < NUM_STAGES; stage++) {
+    cout << " " << stageNames[stage] << "=" << milliseconds(stages[stage]) / options.benchTicks;
+  }
+  cout <<
+    " feed_ms=" << milliseconds(feeding) / options.benchTicks <<
+    " reproduce_ms=" << milliseconds(reproducing) <<
+    " peak_rss_kb=" << usage.ru_maxrss <<
+    " awake_chunks=" << awakeChunks / double(options.benchTicks) <<
+    " chunks=" << WORLD_CHUNKS * WORLD_CHUNKS <<
+  endl;
+}
+
+// runs a fixed seed and writes the checksums of every tick to a golden
+// file, or compares them against one and reports the first divergence
+int runVerify() {
+  bool recording = !options.verifyRecordPath.empty();
+  auto& path = recording ? options.verifyRecordPath : options.verifyPath;
+  long seed = options.seed >= 0 ? options.seed : 1;
+  int generations = options.generations > 0 ? options.generations : 2;
+  double tolerance = options.verifyTolerance;
+
+  FILE* golden = fopen(path.c_str(), recording ? "w" : "r");
+  if (golden == nullptr) {
+    cerr << "Cannot open " << path << endl;
+    return 1;
+  }
+  if (recording) {
+    fprintf(golden, "%s\n", trajectoryHeader(seed, generations).c_str());
+  } else {
+    char line[4096] = "";
+    fgets(line, sizeof(line), golden);
+    if (sscanf(line, "neatpond-trajectory 2 seed %ld generations %d", &seed, &generations) != 2) {
+      cerr << "Not a trajectory file, or one of an older version: " << path << endl;
+      fclose(golden);
+      return 1;
+    }
+    string recorded(line);
+    recorded.erase(recorded.find_last_not_of("\n") + 1);
+    auto expected = trajectoryHeader(seed, generations);
+    // a run with other options diverges anyway, say so before running it
+    auto recordedOptions = recorded.find(" options ");
+    auto expectedOptions = expected.find(" options ");
+    if (recordedOptions == string::npos || recorded.substr(recordedOptions) != expected.substr(expectedOptions)) {
+      cerr << "Trajectory was recorded with other options" << endl;
+      cerr << "  recorded:" << (recordedOptions == string::npos ? string(" none") : recorded.substr(recordedOptions + 25)) << endl;
+      cerr << "  this run: " << trajectoryOptions() << endl;
+      fclose(golden);
+      return 1;
+    }
+    if (recorded != expected) {
+      cerr << "Trajectory was recorded with other sizes: " << recorded << endl;
+      fclose(golden);
+      return 1;
+    }
+  }
+
+  // the seed is all that makes runs repeatable, so start from it here
+  srand(seed);
+  NeatPond pond;
+  int numTicks = 0;
+
+  auto check = [&](int g, int t) {
+    auto actual = checksumPond(pond, g, t);
+    numTicks++;
+    if (recording) {
+      writeChecksums(golden, actual);
+      return true;
+    }
+
+    TickChecksums expected;
+    if (!readChecksums(golden, expected) || expected.generation != g || expected.tick != t) {
+      cout << "Trajectory file ends early or is out of step at generation " << g << ", tick " << t << endl;
+      return false;
+    }
+    bool matches = true;
+    for (int c = 0; c < NUM_CHECKS; c++) {
+      auto& a = actual.checks[c];
+      auto& e = expected.checks[c];
+      if (checkMatches(a, e, tolerance)) { continue; }
+      if (matches) {
+        cout << "First divergence at generation " << g << ", tick " << t <<
+          (t > GENERATION_LIFESPAN ? " (reproduction)" : "") << endl;
+        matches = false;
+      }
+      printf(
+        "  %s: hash %016" PRIx64 " expected %016" PRIx64 ", sum %.17g expected %.17g\n",
+        CHECK_NAMES[c], a.hash, e.hash, a.sum, e.sum
+      );
+    }
+    return matches;
+  };
+
+  // the ticks are numbered like in runHeadless
+  bool matches = check(0, -1);
+  for (int g = 0; matches && g < generations; g++) {
+    for (int t = 0; matches && t <= GENERATION_LIFESPAN + 1; t++) {
+      if (t <= GENERATION_LIFESPAN) {
+        pond.update();
+      } else {
+        pond.reset();
+      }
+      matches = check(g, t);
+    }
+  }
+  fclose(golden);
+
+  if (recording) {
+    cout << "Recorded " << numTicks << " ticks of seed " << seed << " to " << path << endl;
+  } else if (matches) {
+    cout << "Verified " << numTicks << " ticks of seed " << seed <<
+      (tolerance > 0 ? ", within tolerance" : ", bit for bit") << endl;
+  }
+  return matches ? 0 : 1;
+}
+
 void runGUI() {
   SDL_Init(SDL_INIT_EVERYTHING);
 
   Renderer renderer(WINDOW_TITLE, windowWidth, windowHeight);
   NeatPond pond;
+  ReplayRecorder recorder(options.recordPath, options.recordEvery, options.recordFish);
+  ReplayPlayer player;
+  bool replaying = !options.replayPath.empty();
+  int replayGeneration = -1;
+
+  if (replaying && !player.load(options.replayPath)) {
+    SDL_Quit();
+    return;
+  }
+
+  // watching a headless run, with the brain of its best fish
+  bool attached = !options.attachPath.empty();
+  unique_ptr<LiveViewer> viewer;
+  unique_ptr<Network> liveBrain;
+  int liveGeneration = -1;
+  if (attached) {
+    viewer.reset(new LiveViewer(options.attachPath));
+    if (!viewer->isOpen()) {
+      SDL_Quit();
+      return;
+    }
+  }
+  bool simulating = !replaying && !attached;
 
   int speed = SPEED_NORMAL;
   int numGenerations = 0;
   int generationTime = 0;
   float maxFitness = 0.0;
-  vector<float> averageFitnesses;
-  vector<array<float, 3>> averageColors;
+  FitnessHistory history;
+  // generations shown by the chart, 0 shows the whole run
+  int chartSpan = CHART_BUCKETS;
 
   bool closed = false;
   bool displayHud = true;
   auto timeStart = SDL_GetTicks();
   Vector2D camera((WORLD_SIZE - windowWidth) / 2, (WORLD_SIZE - windowHeight) / 2);
   Vector2D mouse;
-  const Vector2D* followPosition = nullptr;
+  // follows the selected fish by index, reproduction reallocates the fishes
+  bool following = false;
   bool mouseDrag = false;
   bool mouseDiscardClick = false;
   int selectedFish = -1;
@@ -59,9 +492,9 @@ void runGUI() {
 
     auto& fishes = pond.getFishes();
 
-    if (followPosition != nullptr) {
-      camera.x = followPosition->x - windowWidth / 2;
-      camera.y = followPosition->y - windowHeight / 2;
+    if (following && selectedFish >= 0 && selectedFish < fishes.size()) {
+      camera.x = fishes[selectedFish].position.x - windowWidth / 2;
+      camera.y = fishes[selectedFish].position.y - windowHeight / 2;
     }
 
     while (SDL_PollEvent(&event)) {
@@ -82,7 +515,7 @@ void runGUI() {
           camera.y = fmin(WORLD_SIZE - windowHeight, fmax(camera.y - yrel, 0));
           if (abs(xrel) > 1 || abs(yrel) > 1) {
             mouseDiscardClick = true;
-            followPosition = nullptr;
+            following = false;
           }
         }
         mouse.x = event.motion.x;
@@ -96,17 +529,9 @@ void runGUI() {
 
       if (event.type == SDL_MOUSEBUTTONUP) {
         mouseDrag = false;
-        if (!mouseDiscardClick) {
-          selectedFish = -1;
-          followPosition = nullptr;
-          for (int i = fishes.size(); i--;) {
-            auto& genome = fishes[i];
-            auto dist = genome.position - (mouse + camera);
-            if (fabs(dist.x) < 80 && fabs(dist.y) < 80) {
-              selectedFish = i;
-              followPosition = &genome.position;
-            }
-          }
+        if (!mouseDiscardClick && simulating) {
+          selectedFish = pond.pickFish(mouse + camera, 80);
+          following = selectedFish >= 0;
         }
       }
 
@@ -116,41 +541,90 @@ void runGUI() {
         if (key == SDL_SCANCODE_ESCAPE) {
           closed = true;
         }
-        if (key == SDL_SCANCODE_F) {
-          pond.spawnFood(mouse + camera);
-        }
-        if (key == SDL_SCANCODE_SPACE) {
-          speed = (speed + 1) % NUM_SPEEDS;
-        }
         if (key == SDL_SCANCODE_TAB) {
           displayHud = !displayHud;
         }
+        if (key == SDL_SCANCODE_LEFTBRACKET) {
+          chartSpan = chartSpan == 0 ? history.size() : chartSpan;
+          chartSpan = max(10, chartSpan / 2);
+        }
+        if (key == SDL_SCANCODE_RIGHTBRACKET && chartSpan != 0) {
+          chartSpan = chartSpan * 2 >= history.size() ? 0 : chartSpan * 2;
+        }
+
+        if (replaying) {
+          if (key == SDL_SCANCODE_SPACE) {
+            player.paused = !player.paused;
+          }
+          if (key == SDL_SCANCODE_LEFT) {
+            player.seek(-10);
+          }
+          if (key == SDL_SCANCODE_RIGHT) {
+            player.seek(10);
+          }
+          if (key == SDL_SCANCODE_UP) {
+            player.speed = fmin(64.f, player.speed * 2);
+          }
+          if (key == SDL_SCANCODE_DOWN) {
+            player.speed = fmax(1 / 16.f, player.speed / 2);
+          }
+          if (key == SDL_SCANCODE_PAGEUP) {
+            player.select(player.index() - 1);
+          }
+          if (key == SDL_SCANCODE_PAGEDOWN) {
+            player.select(player.index() + 1);
+          }
+        } else if (simulating) {
+          if (key == SDL_SCANCODE_F) {
+            pond.spawnFood(mouse + camera);
+          }
+          if (key == SDL_SCANCODE_SPACE) {
+            speed = (speed + 1) % NUM_SPEEDS;
+          }
+        }
       }
     }
 
-    pond.update();
-
-    if (speed != SPEED_NORMAL && ++generationTime >= GENERATION_LIFESPAN) {
-      auto averageFitness = pond.reset();
-      auto numFishes = fishes.size();
-
-      float r = 0.0;
-      float g = 0.0;
-      float b = 0.0;
-
-      for (auto& genome : fishes) {
-        r += genome.genes[TRAIT_RED];
-        g += genome.genes[TRAIT_GREEN];
-        b += genome.genes[TRAIT_BLUE];
+    if (replaying) {
+      player.update();
+      if (player.generation() != replayGeneration) {
+        replayGeneration = player.generation();
+        cout << "Replay generation: " << replayGeneration << endl;
+      }
+    } else if (attached) {
+      if (viewer->read()) {
+        auto& snapshot = viewer->snapshot;
+        for (int i = 0; i < snapshot.numHistory; i++) {
+          auto& entry = snapshot.history[i];
+          if (entry.generation <= liveGeneration) { continue; }
+          liveGeneration = entry.generation;
+          maxFitness = fmax(maxFitness, entry.fitness);
+          history.push(entry.fitness, { entry.color[0], entry.color[1], entry.color[2] });
+        }
+        // the brain is rebuilt from the genes and rerun on the inputs,
+        // which gives the activations the publisher saw. A fixed point
+        // brain only approximates those, so its own outputs are shown.
+        liveBrain.reset();
+        if (snapshot.selected >= 0) {
+          liveBrain.reset(new Network(Fish::networkOf(DNA(snapshot.genes, snapshot.genes + DNA_LENGTH))));
+          vector<double> input(snapshot.input, snapshot.input + NUM_INPUTS);
+          liveBrain->feedForward(input);
+          if (snapshot.quantizedBits != 0) {
+            liveBrain->setResults(vector<double>(snapshot.output, snapshot.output + NUM_OUTPUTS));
+          }
+        }
       }
+    } else {
+      pond.update();
+      recorder.recordTick(pond, numGenerations);
+    }
 
-      r /= float(numFishes);
-      g /= float(numFishes);
-      b /= float(numFishes);
+    if (simulating && speed != SPEED_NORMAL && ++generationTime >= GENERATION_LIFESPAN) {
+      recorder.endGeneration();
+      auto averageFitness = pond.reset();
 
       maxFitness = fmax(maxFitness, averageFitness);
-      averageFitnesses.push_back(averageFitness);
-      averageColors.push_back({r, g, b});
+      history.push(averageFitness, averageColor(fishes));
 
       cout <<
         "Generation: " << numGenerations <<
@@ -169,29 +643,27 @@ void runGUI() {
 
       renderer.translate(-camera.x, -camera.y);
 
-      int chunkSize = GRID_SIZE;
-      for (int x = 0; x < WORLD_CHUNKS; x++) {
-        for (int y = 0; y < WORLD_CHUNKS; y++) {
-          if ((x + y) % 2 == 0) {
-            renderer.color(3, 5, 25);
-            renderer.rect(
-              x * chunkSize,
-              y * chunkSize,
-              chunkSize,
-              chunkSize
-            );
-          }
+      renderer.drawChunks();
+
+      if (replaying) {
+        if (player.numFrames() > 0) {
+          renderer.drawReplay(player.frame(), player.colors());
         }
+      } else if (attached) {
+        renderer.drawReplay(viewer->frame, viewer->colors);
+      } else {
+        renderer.drawPond(pond, selectedFish);
       }
 
-      renderer.drawPond(pond, selectedFish);
-
       renderer.translate(0, 0);
       if (displayHud) {
         if (selectedFish >= 0 && selectedFish < fishes.size()) {
-          renderer.drawNetwork(fishes[selectedFish].brain);
+          renderer.drawNetwork(fishes[selectedFish].activeNetwork());
+        }
+        if (liveBrain) {
+          renderer.drawNetwork(*liveBrain);
         }
-        renderer.drawChart(averageFitnesses, averageColors, maxFitness);
+        renderer.drawChart(history.recent(chartSpan, CHART_BUCKETS), maxFitness);
       }
 
       renderer.present();
@@ -202,8 +674,17 @@ void runGUI() {
 }
 
 int main(int argc, char **argv) {
-  srand(time(NULL));
-  if (argc > 1 && strcmp(argv[1], "-headless") == 0) {
+  parseOptions(argc, argv);
+  srand(options.seed >= 0 ? options.seed : time(NULL));
+  if (!options.verifyRecordPath.empty() || !options.verifyPath.empty()) {
+    return runVerify();
+  } else if (options.benchTicks > 0) {
+    runBenchmark();
+  } else if (options.validateQuantized) {
+    runQuantizedReport();
+  } else if (options.headless && options.environments > 1) {
+    runVectorized();
+  } else if (options.headless) {
     runHeadless();
   } else {
     runGUI();
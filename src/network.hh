@@ -25,13 +25,10 @@ private:
   vector<double> connectionWeights;
 
 public:
-  ~Neuron() { }
-
   Neuron(unsigned index, unsigned numOutputs) : index (index) {
-    for (auto i(0); i < numOutputs; i++) {
-      // create a new connection with a random weight
-      connectionWeights.push_back(rand() / double(RAND_MAX));
-    }
+    // the weights are set with Network::setWeights, leaving rand() alone
+    // keeps networks safe to construct on several threads
+    connectionWeights.assign(numOutputs, 0.0);
   }
   void feedForward(Layer &previousLayer) {
     auto sum = 0.f;
@@ -59,7 +56,7 @@ class Network {
 private:
   vector<Layer> layers;
 public:
-  ~Network() { }
+  Network() { }
 
   Network(vector<unsigned> topology) {
     auto numLayers = topology.size();
@@ -107,6 +104,13 @@ public:
     }
   }
 
+  // overrides the outputs, e.g. with those of a fixed point copy
+  void setResults(const vector<double> &results) {
+    for (int n = 0; n < layers.back().size() - 1 && n < results.size(); ++n) {
+      layers.back()[n].setOutput(results[n]);
+    }
+  }
+
   void getResults(vector<double> &results) const {
     results.clear();
     for (int n = 0; n < layers.back().size() - 1; ++n) {
@@ -0,0 +1,246 @@
+#ifndef novelty_h
+#define novelty_h
+
+#include "parallel.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+using namespace std;
+
+// Keeps the k smallest distances seen so far.
+struct Neighbours {
+  size_t k;
+  priority_queue<float> distances;
+
+  Neighbours(size_t k): k(k) { }
+
+  // squared distance a candidate has to beat
+  float bound() const {
+    return distances.size() < k ? INFINITY : distances.top();
+  }
+
+  void add(float distance) {
+    if (distances.size() < k) {
+      distances.push(distance);
+    } else if (distance < distances.top()) {
+      distances.pop();
+      distances.push(distance);
+    }
+  }
+
+  float meanDistance() const {
+    auto copy = distances;
+    float sum = 0.f;
+    for (; !copy.empty(); copy.pop()) { sum += sqrtf(copy.top()); }
+    return distances.empty() ? 0.f : sum / distances.size();
+  }
+};
+
+template<size_t D>
+float squaredDistance(const array<float, D>& a, const array<float, D>& b) {
+  float sum = 0.f;
+  for (size_t d = 0; d < D; d++) {
+    float diff = a[d] - b[d];
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+// Static kd-tree stored implicitly: the median of every range is its
+// node, split along the axis with the widest spread.
+template<size_t D>
+class KDTree {
+public:
+  using Point = array<float, D>;
+
+private:
+  vector<Point> points;
+  vector<int> ids;
+  vector<uint8_t> axes;
+
+  // arranges ids[begin, end) into a subtree, splitting at the median
+  void build(int begin, int end) {
+    if (end - begin <= 1) { return; }
+    Point low = points[ids[begin]];
+    Point high = low;
+    for (int i = begin + 1; i < end; i++) {
+      auto& point = points[ids[i]];
+      for (size_t d = 0; d < D; d++) {
+        low[d] = fmin(low[d], point[d]);
+        high[d] = fmax(high[d], point[d]);
+      }
+    }
+    uint8_t axis = 0;
+    for (size_t d = 1; d < D; d++) {
+      if (high[d] - low[d] > high[axis] - low[axis]) { axis = d; }
+    }
+
+    int mid = (begin + end) / 2;
+    nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end, [&](int a, int b) {
+      return points[a][axis] < points[b][axis];
+    });
+    axes[mid] = axis;
+
+    build(begin, mid);
+    build(mid + 1, end);
+  }
+
+  void search(int begin, int end, const Point& query, int skipId, Neighbours& result) const {
+    if (begin >= end) { return; }
+    int mid = (begin + end) / 2;
+    auto& point = points[mid];
+    if (ids[mid] != skipId) {
+      result.add(squaredDistance(point, query));
+    }
+    if (end - begin == 1) { return; }
+
+    float diff = query[axes[mid]] - point[axes[mid]];
+    bool left = diff < 0;
+    search(left ? begin : mid + 1, left ? mid : end, query, skipId, result);
+    if (diff * diff < result.bound()) {
+      search(left ? mid + 1 : begin, left ? end : mid, query, skipId, result);
+    }
+  }
+
+public:
+  KDTree() { }
+
+  // ids of the points are their indices in the given vector
+  KDTree(const vector<Point>& unordered) {
+    for (int i = 0; i < unordered.size(); i++) { ids.push_back(i); }
+    points = unordered;
+    axes.assign(points.size(), 0);
+    build(0, points.size());
+    // store the points in tree order for locality
+    for (int i = 0; i < ids.size(); i++) { points[i] = unordered[ids[i]]; }
+  }
+
+  size_t size() const {
+    return points.size();
+  }
+
+  const vector<Point>& getPoints() const {
+    return points;
+  }
+
+  // adds the distances to points near query, ignoring the point skipId
+  void nearest(const Point& query, Neighbours& result, int skipId = -1) const {
+    search(0, points.size(), query, skipId, result);
+  }
+};
+
+// Growing set of points searchable by nearest neighbours. New points
+// go into a small buffer that is scanned linearly; full buffers are
+// merged into kd-trees of doubling size, like a binary counter, so an
+// insert costs O(log^2 n) amortized and a query visits O(log n) trees.
+template<size_t D>
+class NoveltyArchive {
+public:
+  using Point = array<float, D>;
+
+private:
+  size_t bufferSize;
+  vector<Point> buffer;
+  vector<KDTree<D>> trees;
+  size_t total = 0;
+
+public:
+  NoveltyArchive(size_t bufferSize = 64): bufferSize(bufferSize) { }
+
+  size_t size() const {
+    return total;
+  }
+
+  void add(const Point& point) {
+    buffer.push_back(point);
+    total++;
+    if (buffer.size() < bufferSize) { return; }
+
+    vector<Point> merged;
+    merged.swap(buffer);
+    int slot = 0;
+    for (; slot < trees.size() && trees[slot].size() > 0; slot++) {
+      auto& points = trees[slot].getPoints();
+      merged.insert(merged.end(), points.begin(), points.end());
+      trees[slot] = KDTree<D>();
+    }
+    if (slot == trees.size()) {
+      trees.push_back(KDTree<D>());
+    }
+    trees[slot] = KDTree<D>(merged);
+  }
+
+  void nearest(const Point& query, Neighbours& result) const {
+    for (auto& point : buffer) {
+      result.add(squaredDistance(point, query));
+    }
+    for (auto& tree : trees) {
+      tree.nearest(query, result);
+    }
+  }
+};
+
+// Novelty search (Lehman & Stanley): a behaviour is novel when it is far
+// from its k nearest neighbours among the current population and an
+// archive of past behaviours. Behaviours that beat the novelty threshold
+// enter the archive, and the threshold adapts to keep the inflow steady.
+template<size_t D>
+class NoveltySearch {
+public:
+  using Point = array<float, D>;
+
+private:
+  NoveltyArchive<D> archive;
+  size_t k;
+  float threshold;
+  int generationsWithoutAdditions = 0;
+
+public:
+  NoveltySearch(size_t k = 15, float threshold = 0.05f):
+    k(k),
+    threshold(threshold) { }
+
+  size_t archiveSize() const {
+    return archive.size();
+  }
+
+  // novelty of every behaviour, adding the most novel ones to the archive
+  vector<float> evaluate(const vector<Point>& behaviors) {
+    KDTree<D> population(behaviors);
+    vector<float> novelty(behaviors.size(), 0.f);
+
+    workers().parallelFor(behaviors.size(), [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; i++) {
+        Neighbours neighbours(k);
+        population.nearest(behaviors[i], neighbours, i);
+        archive.nearest(behaviors[i], neighbours);
+        novelty[i] = neighbours.meanDistance();
+      }
+    });
+
+    int added = 0;
+    for (int i = 0; i < behaviors.size(); i++) {
+      if (novelty[i] > threshold) {
+        archive.add(behaviors[i]);
+        added++;
+      }
+    }
+
+    if (added > 4) {
+      threshold *= 1.05f;
+    }
+    generationsWithoutAdditions = added > 0 ? 0 : generationsWithoutAdditions + 1;
+    if (generationsWithoutAdditions >= 5) {
+      threshold *= 0.95f;
+      generationsWithoutAdditions = 0;
+    }
+    return novelty;
+  }
+};
+
+#endif
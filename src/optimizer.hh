@@ -0,0 +1,412 @@
+#ifndef optimizer_h
+#define optimizer_h
+
+#include "utils.hh"
+#include "genetics.hh"
+#include "options.hh"
+#include "parallel.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Turns a scored generation into the next one. The genomes of the
+// population are the candidates being evaluated, so an optimizer may
+// rely on their order staying the same between calls to step().
+template<class T>
+struct Optimizer {
+  virtual ~Optimizer() { }
+
+  // scores the genomes, replaces them with the next generation
+  // and returns the average fitness of the scored generation
+  virtual float step(Population<T>& population) = 0;
+};
+
+template<class T>
+struct GeneticOptimizer : Optimizer<T> {
+  float mutationRate;
+
+  GeneticOptimizer(float mutationRate): mutationRate(mutationRate) { }
+
+  float step(Population<T>& population) override {
+    return population.reproduce(population.genomes, mutationRate);
+  }
+};
+
+template<class T>
+float scoreGenomes(Population<T>& population, vector<float>& fitnesses) {
+  auto fitnessSum = 0.0f;
+  fitnesses.clear();
+  for (auto& g : population.genomes) {
+    fitnesses.push_back(g.calculateFitness());
+    fitnessSum += fitnesses.back();
+  }
+  return fitnessSum / (float)max<size_t>(1, fitnesses.size());
+}
+
+// Index of the genome with the highest fitness.
+int fittest(const vector<float>& fitnesses) {
+  return max_element(fitnesses.begin(), fitnesses.end()) - fitnesses.begin();
+}
+
+// True while no genome has scored differently from the others, as
+// before the first tick or while nothing has eaten yet.
+bool unscored(const vector<float>& fitnesses) {
+  return fitnesses.empty() ||
+    *min_element(fitnesses.begin(), fitnesses.end()) == *max_element(fitnesses.begin(), fitnesses.end());
+}
+
+// Centered ranks in [-0.5, 0.5], which makes the update invariant
+// to any monotonic transformation of the fitness. Ties share their
+// average rank, so equal fitnesses pull the update nowhere.
+vector<double> centeredRanks(const vector<float>& fitnesses) {
+  auto n = fitnesses.size();
+  vector<int> order(n);
+  vector<double> ranks(n, 0.0);
+  for (int i = 0; i < n; i++) { order[i] = i; }
+  sort(order.begin(), order.end(), [&](int a, int b) {
+    return fitnesses[a] < fitnesses[b];
+  });
+  for (int first = 0; n > 1 && first < n;) {
+    int last = first;
+    while (last + 1 < n && fitnesses[order[last + 1]] == fitnesses[order[first]]) { last++; }
+    double rank = (first + last) / 2.0 / double(n - 1) - 0.5;
+    for (int r = first; r <= last; r++) { ranks[order[r]] = rank; }
+    first = last + 1;
+  }
+  return ranks;
+}
+
+double clampGene(double gene) {
+  return fmax(0.0, fmin(1.0, gene));
+}
+
+// Natural evolution strategy (Salimans et al. 2017). Every generation is
+// a set of antithetic pairs center +- sigma * epsilon, and the center
+// follows the rank shaped fitness gradient with Adam.
+template<class T>
+struct EvolutionStrategy : Optimizer<T> {
+  DNA center;
+  float sigma;
+  float learningRate;
+  float weightDecay = 0.005f;
+  vector<vector<double>> noise;
+  vector<float> fitnesses;
+
+  // Adam state
+  vector<double> moment;
+  vector<double> velocity;
+  int iteration = 0;
+
+  EvolutionStrategy(float sigma, float learningRate):
+    sigma(sigma),
+    learningRate(learningRate) { }
+
+  float step(Population<T>& population) override {
+    auto numGenomes = population.genomes.size();
+    auto averageFitness = scoreGenomes(population, fitnesses);
+
+    if (center.empty()) {
+      // random generations live on until one of them tells its
+      // genomes apart, then the search starts from the best of it
+      if (unscored(fitnesses)) { return averageFitness; }
+      center = population.genomes[fittest(fitnesses)].genes;
+      moment.assign(center.size(), 0.0);
+      velocity.assign(center.size(), 0.0);
+    } else {
+      updateCenter();
+    }
+
+    sample(numGenomes);
+
+    population.genomes = buildGenomes<T>(numGenomes, [&](size_t i) {
+      return candidate(i);
+    });
+    return averageFitness;
+  }
+
+  DNA candidate(int i) const {
+    DNA genes(center);
+    if (i / 2 >= noise.size()) { return genes; }
+    auto& epsilon = noise[i / 2];
+    auto sign = i % 2 == 0 ? 1.0 : -1.0;
+    for (int j = 0; j < genes.size(); j++) {
+      genes[j] = clampGene(genes[j] + sign * sigma * epsilon[j]);
+    }
+    return genes;
+  }
+
+  void updateCenter() {
+    auto ranks = centeredRanks(fitnesses);
+    auto dim = center.size();
+    vector<double> gradient(dim, 0.0);
+
+    for (int k = 0; k < noise.size(); k++) {
+      double weight = ranks[2 * k] - ranks[2 * k + 1];
+      for (int j = 0; j < dim; j++) {
+        gradient[j] += weight * noise[k][j];
+      }
+    }
+
+    const double beta1 = 0.9;
+    const double beta2 = 0.999;
+    iteration++;
+    for (int j = 0; j < dim; j++) {
+      double g = gradient[j] / (2 * noise.size() * sigma) - weightDecay * (center[j] - 0.5);
+      moment[j] = beta1 * moment[j] + (1 - beta1) * g;
+      velocity[j] = beta2 * velocity[j] + (1 - beta2) * g * g;
+      double m = moment[j] / (1 - pow(beta1, iteration));
+      double v = velocity[j] / (1 - pow(beta2, iteration));
+      center[j] = clampGene(center[j] + learningRate * m / (sqrt(v) + 1e-8));
+    }
+  }
+
+  void sample(size_t numGenomes) {
+    noise.resize(numGenomes / 2);
+    vector<unsigned> seeds;
+    for (auto k = noise.size(); k--;) {
+      seeds.push_back(rand());
+    }
+    workers().parallelFor(noise.size(), [&](size_t begin, size_t end) {
+      for (auto k = begin; k < end; k++) {
+        mt19937 rng(seeds[k]);
+        normal_distribution<double> gaussian;
+        noise[k].resize(center.size());
+        for (auto& e : noise[k]) { e = gaussian(rng); }
+      }
+    });
+  }
+};
+
+// Eigen decomposition of the symmetric n x n matrix a (row major) with
+// cyclic Jacobi rotations, eigenvectors end up in the columns of vectors.
+void symmetricEigen(vector<double> a, int n, vector<double>& values, vector<double>& vectors) {
+  vectors.assign(n * n, 0.0);
+  for (int i = 0; i < n; i++) { vectors[i * n + i] = 1.0; }
+
+  for (int sweep = 0; sweep < 50; sweep++) {
+    double off = 0.0;
+    for (int p = 0; p < n; p++) {
+      for (int q = p + 1; q < n; q++) { off += a[p * n + q] * a[p * n + q]; }
+    }
+    if (off < 1e-24) { break; }
+
+    for (int p = 0; p < n; p++) {
+      for (int q = p + 1; q < n; q++) {
+        double apq = a[p * n + q];
+        if (fabs(apq) < 1e-30) { continue; }
+        double theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+        double t = (theta >= 0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1));
+        double c = 1 / sqrt(t * t + 1);
+        double s = t * c;
+        for (int k = 0; k < n; k++) {
+          double akp = a[k * n + p];
+          double akq = a[k * n + q];
+          a[k * n + p] = c * akp - s * akq;
+          a[k * n + q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < n; k++) {
+          double apk = a[p * n + k];
+          double aqk = a[q * n + k];
+          a[p * n + k] = c * apk - s * aqk;
+          a[q * n + k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < n; k++) {
+          double vkp = vectors[k * n + p];
+          double vkq = vectors[k * n + q];
+          vectors[k * n + p] = c * vkp - s * vkq;
+          vectors[k * n + q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+
+  values.resize(n);
+  for (int i = 0; i < n; i++) { values[i] = a[i * n + i]; }
+}
+
+// (mu/mu_w, lambda)-CMA-ES following Hansen's tutorial. Candidates are
+// clamped into the gene range, the unclamped steps drive the update.
+template<class T>
+struct CMAES : Optimizer<T> {
+  int n = 0;
+  int mu = 0;
+  double muEff, cc, cs, c1, cmu, damps, chiN;
+  vector<double> weights;
+
+  DNA mean;
+  double sigma;
+  vector<double> pc, ps;
+  vector<double> C, B, D;
+  vector<vector<double>> steps;
+  vector<float> fitnesses;
+  int generation = 0;
+
+  CMAES(float sigma): sigma(sigma) { }
+
+  void initialize(const DNA& start, int lambda) {
+    n = start.size();
+    mu = max(1, lambda / 2);
+    mean = start;
+
+    weights.clear();
+    double weightSum = 0.0;
+    for (int i = 0; i < mu; i++) {
+      weights.push_back(log(mu + 0.5) - log(i + 1));
+      weightSum += weights.back();
+    }
+    double weightSquares = 0.0;
+    for (auto& w : weights) {
+      w /= weightSum;
+      weightSquares += w * w;
+    }
+    muEff = 1 / weightSquares;
+
+    cc = (4 + muEff / n) / (n + 4 + 2 * muEff / n);
+    cs = (muEff + 2) / (n + muEff + 5);
+    c1 = 2 / ((n + 1.3) * (n + 1.3) + muEff);
+    cmu = min(1 - c1, 2 * (muEff - 2 + 1 / muEff) / ((n + 2) * (n + 2) + muEff));
+    damps = 1 + 2 * fmax(0, sqrt((muEff - 1) / (n + 1)) - 1) + cs;
+    chiN = sqrt(n) * (1 - 1 / (4.0 * n) + 1 / (21.0 * n * n));
+
+    pc.assign(n, 0.0);
+    ps.assign(n, 0.0);
+    C.assign(n * n, 0.0);
+    B.assign(n * n, 0.0);
+    D.assign(n, 1.0);
+    for (int i = 0; i < n; i++) {
+      C[i * n + i] = 1.0;
+      B[i * n + i] = 1.0;
+    }
+  }
+
+  float step(Population<T>& population) override {
+    int lambda = population.genomes.size();
+    auto averageFitness = scoreGenomes(population, fitnesses);
+
+    if (mean.empty()) {
+      // see EvolutionStrategy::step
+      if (unscored(fitnesses)) { return averageFitness; }
+      initialize(population.genomes[fittest(fitnesses)].genes, lambda);
+    } else {
+      update();
+    }
+
+    sample(lambda);
+
+    population.genomes = buildGenomes<T>(lambda, [&](size_t i) {
+      DNA genes(n);
+      for (int j = 0; j < n; j++) {
+        genes[j] = clampGene(mean[j] + sigma * steps[i][j]);
+      }
+      return genes;
+    });
+    return averageFitness;
+  }
+
+  void sample(int lambda) {
+    steps.resize(lambda);
+    vector<unsigned> seeds;
+    for (int i = lambda; i--;) {
+      seeds.push_back(rand());
+    }
+    workers().parallelFor(lambda, [&](size_t begin, size_t end) {
+      vector<double> z(n);
+      for (auto i = begin; i < end; i++) {
+        mt19937 rng(seeds[i]);
+        normal_distribution<double> gaussian;
+        for (auto& e : z) { e = gaussian(rng); }
+        // y = B * D * z
+        steps[i].assign(n, 0.0);
+        for (int r = 0; r < n; r++) {
+          double sum = 0.0;
+          for (int c = 0; c < n; c++) { sum += B[r * n + c] * D[c] * z[c]; }
+          steps[i][r] = sum;
+        }
+      }
+    });
+  }
+
+  void update() {
+    generation++;
+    vector<int> order(steps.size());
+    for (int i = 0; i < order.size(); i++) { order[i] = i; }
+    partial_sort(order.begin(), order.begin() + mu, order.end(), [&](int a, int b) {
+      return fitnesses[a] > fitnesses[b];
+    });
+
+    vector<double> yw(n, 0.0);
+    for (int i = 0; i < mu; i++) {
+      for (int j = 0; j < n; j++) { yw[j] += weights[i] * steps[order[i]][j]; }
+    }
+    for (int j = 0; j < n; j++) {
+      mean[j] += sigma * yw[j];
+    }
+
+    // C^-1/2 * yw = B * D^-1 * B^T * yw
+    vector<double> projected(n, 0.0);
+    for (int c = 0; c < n; c++) {
+      double sum = 0.0;
+      for (int r = 0; r < n; r++) { sum += B[r * n + c] * yw[r]; }
+      projected[c] = sum / D[c];
+    }
+    double psNorm = 0.0;
+    for (int r = 0; r < n; r++) {
+      double sum = 0.0;
+      for (int c = 0; c < n; c++) { sum += B[r * n + c] * projected[c]; }
+      ps[r] = (1 - cs) * ps[r] + sqrt(cs * (2 - cs) * muEff) * sum;
+      psNorm += ps[r] * ps[r];
+    }
+    psNorm = sqrt(psNorm);
+
+    bool hsig = psNorm / sqrt(1 - pow(1 - cs, 2 * generation)) / chiN < 1.4 + 2.0 / (n + 1);
+    for (int j = 0; j < n; j++) {
+      pc[j] = (1 - cc) * pc[j] + (hsig ? sqrt(cc * (2 - cc) * muEff) : 0.0) * yw[j];
+    }
+
+    double decay = 1 - c1 - cmu + (hsig ? 0.0 : c1 * cc * (2 - cc));
+    workers().parallelFor(n, [&](size_t begin, size_t end) {
+      for (auto r = begin; r < end; r++) {
+        for (int c = 0; c < n; c++) {
+          double rankMu = 0.0;
+          for (int i = 0; i < mu; i++) {
+            auto& y = steps[order[i]];
+            rankMu += weights[i] * y[r] * y[c];
+          }
+          C[r * n + c] = decay * C[r * n + c] + c1 * pc[r] * pc[c] + cmu * rankMu;
+        }
+      }
+    });
+
+    sigma *= exp((cs / damps) * (psNorm / chiN - 1));
+
+    vector<double> values;
+    symmetricEigen(C, n, values, B);
+    for (int j = 0; j < n; j++) {
+      D[j] = sqrt(fmax(values[j], 1e-20));
+    }
+  }
+};
+
+template<class T>
+unique_ptr<Optimizer<T>> makeOptimizer(float mutationRate) {
+  switch (options.optimizer) {
+    case OPTIMIZER_ES:
+      return unique_ptr<Optimizer<T>>(new EvolutionStrategy<T>(
+        options.sigma > 0 ? options.sigma : 0.02f,
+        options.learningRate
+      ));
+    case OPTIMIZER_CMAES:
+      return unique_ptr<Optimizer<T>>(new CMAES<T>(
+        options.sigma > 0 ? options.sigma : 0.1f
+      ));
+    default:
+      return unique_ptr<Optimizer<T>>(new GeneticOptimizer<T>(mutationRate));
+  }
+}
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef options_h
+#define options_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+enum {
+  CAPTURE_PNG,
+  CAPTURE_RAW,
+  NUM_CAPTURE_FORMATS
+};
+
+enum {
+  OPTIMIZER_GENETIC,
+  OPTIMIZER_ES,
+  OPTIMIZER_CMAES,
+  NUM_OPTIMIZERS
+};
+
+enum {
+  SELECTION_RANK,
+  SELECTION_TOURNAMENT,
+  SELECTION_SUS,
+  SELECTION_TRUNCATION,
+  NUM_SELECTIONS
+};
+
+struct Selection {
+  int strategy = SELECTION_RANK;
+  // fittest genomes carried over unchanged into the next generation
+  size_t elites = 0;
+  int tournamentSize = 3;
+  // share of the population that truncation selection breeds from
+  float truncation = 0.2f;
+};
+
+struct Options {
+  bool headless = false;
+  // number of ponds stepped in lockstep by the headless runner
+  int environments = 1;
+  // worker threads, 0 picks one per hardware thread
+  int threads = 0;
+  int optimizer = OPTIMIZER_GENETIC;
+  // initial step size of the evolution strategies, in gene units
+  float sigma = 0.f;
+  float learningRate = 0.01f;
+  Selection selection;
+  // replay file written while evolving, and the generations it holds
+  string recordPath;
+  int recordEvery = 1;
+  int recordFish = -1;
+  // replay file played back by the GUI instead of simulating
+  string replayPath;
+  // shared memory a headless run publishes every publishEvery ticks,
+  // and the one the GUI watches instead of simulating
+  string publishPath;
+  int publishEvery = 10;
+  string attachPath;
+  // offscreen capture of headless runs
+  string capturePath;
+  int captureFormat = CAPTURE_PNG;
+  int captureWidth = 960;
+  int captureHeight = 720;
+  // capture every nth generation, one frame every captureTicks ticks
+  int captureEvery = 1;
+  int captureTicks = 1;
+  float captureFps = 30.f;
+  // share of novelty in the fitness, 1 is pure novelty search
+  float noveltyWeight = 0.f;
+  int noveltyNeighbours = 15;
+  // directory the best brain of every exportEvery-th generation goes to
+  string exportPath;
+  int exportEvery = 1;
+  // exported champions loaded as fixed opponents
+  vector<string> championPaths;
+  // fixed point brain inference with 8 or 16 bit weights, 0 is off
+  int quantizedBits = 0;
+  bool validateQuantized = false;
+  // ticks timed by the benchmark, 0 is off
+  int benchTicks = 0;
+  // seed of rand(), negative seeds from the clock
+  long seed = -1;
+  // headless runs stop after this many generations, 0 runs forever
+  int generations = 0;
+  // food sensors are refreshed every senseEvery ticks, staggered
+  int senseEvery = 1;
+  bool senseAdaptive = false;
+  // trajectory checksums written to, or compared against, a golden file
+  string verifyRecordPath;
+  string verifyPath;
+  // relative tolerance of the comparison, 0 compares bit for bit
+  double verifyTolerance = 0.0;
+  // chance per tick that a chunk grows a food, up to MAX_FOOD_PER_CHUNK
+  float foodRegrowth = 0.f;
+  // replace fish one by one as they retire instead of by generation
+  bool steadyState = false;
+};
+
+Options options;
+
+void parseOptions(int argc, char **argv) {
+  bool selectionChosen = false;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (strcmp(arg, "-headless") == 0) {
+      options.headless = true;
+    } else if (strcmp(arg, "-envs") == 0 && hasValue) {
+      options.environments = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-threads") == 0 && hasValue) {
+      options.threads = max(0, atoi(argv[++i]));
+    } else if (strcmp(arg, "-optimizer") == 0 && hasValue) {
+      const char* name = argv[++i];
+      if (strcmp(name, "ga") == 0) {
+        options.optimizer = OPTIMIZER_GENETIC;
+      } else if (strcmp(name, "es") == 0) {
+        options.optimizer = OPTIMIZER_ES;
+      } else if (strcmp(name, "cmaes") == 0) {
+        options.optimizer = OPTIMIZER_CMAES;
+      } else {
+        cerr << "Unknown optimizer: " << name << endl;
+      }
+    } else if (strcmp(arg, "-sigma") == 0 && hasValue) {
+      options.sigma = atof(argv[++i]);
+    } else if (strcmp(arg, "-learning-rate") == 0 && hasValue) {
+      options.learningRate = atof(argv[++i]);
+    } else if (strcmp(arg, "-selection") == 0 && hasValue) {
+      const char* name = argv[++i];
+      selectionChosen = true;
+      if (strcmp(name, "rank") == 0) {
+        options.selection.strategy = SELECTION_RANK;
+      } else if (strcmp(name, "tournament") == 0) {
+        options.selection.strategy = SELECTION_TOURNAMENT;
+      } else if (strcmp(name, "sus") == 0) {
+        options.selection.strategy = SELECTION_SUS;
+      } else if (strcmp(name, "truncation") == 0) {
+        options.selection.strategy = SELECTION_TRUNCATION;
+      } else {
+        cerr << "Unknown selection: " << name << endl;
+      }
+    } else if (strcmp(arg, "-elites") == 0 && hasValue) {
+      options.selection.elites = max(0, atoi(argv[++i]));
+    } else if (strcmp(arg, "-tournament-size") == 0 && hasValue) {
+      options.selection.tournamentSize = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-truncation") == 0 && hasValue) {
+      options.selection.truncation = fmax(0.0, fmin(1.0, atof(argv[++i])));
+    } else if (strcmp(arg, "-record") == 0 && hasValue) {
+      options.recordPath = argv[++i];
+    } else if (strcmp(arg, "-record-every") == 0 && hasValue) {
+      options.recordEvery = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-record-fish") == 0 && hasValue) {
+      options.recordFish = atoi(argv[++i]);
+    } else if (strcmp(arg, "-replay") == 0 && hasValue) {
+      options.replayPath = argv[++i];
+    } else if (strcmp(arg, "-publish") == 0 && hasValue) {
+      options.publishPath = argv[++i];
+    } else if (strcmp(arg, "-publish-every") == 0 && hasValue) {
+      options.publishEvery = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-attach") == 0 && hasValue) {
+      options.attachPath = argv[++i];
+    } else if (strcmp(arg, "-capture") == 0 && hasValue) {
+      options.capturePath = argv[++i];
+    } else if (strcmp(arg, "-capture-format") == 0 && hasValue) {
+      const char* name = argv[++i];
+      if (strcmp(name, "png") == 0) {
+        options.captureFormat = CAPTURE_PNG;
+      } else if (strcmp(name, "raw") == 0) {
+        options.captureFormat = CAPTURE_RAW;
+      } else {
+        cerr << "Unknown capture format: " << name << endl;
+      }
+    } else if (strcmp(arg, "-capture-size") == 0 && hasValue) {
+      int w, h;
+      if (sscanf(argv[++i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+        options.captureWidth = w;
+        options.captureHeight = h;
+      } else {
+        cerr << "Capture size must look like 960x720" << endl;
+      }
+    } else if (strcmp(arg, "-capture-every") == 0 && hasValue) {
+      options.captureEvery = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-capture-ticks") == 0 && hasValue) {
+      options.captureTicks = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-capture-fps") == 0 && hasValue) {
+      options.captureFps = fmax(1.0, atof(argv[++i]));
+    } else if (strcmp(arg, "-novelty") == 0 && hasValue) {
+      options.noveltyWeight = fmax(0.0, fmin(1.0, atof(argv[++i])));
+    } else if (strcmp(arg, "-novelty-k") == 0 && hasValue) {
+      options.noveltyNeighbours = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-export") == 0 && hasValue) {
+      options.exportPath = argv[++i];
+    } else if (strcmp(arg, "-export-every") == 0 && hasValue) {
+      options.exportEvery = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-champion") == 0 && hasValue) {
+      options.championPaths.push_back(argv[++i]);
+    } else if (strcmp(arg, "-quantized") == 0 && hasValue) {
+      options.quantizedBits = atoi(argv[++i]);
+      if (options.quantizedBits != 8 && options.quantizedBits != 16) {
+        cerr << "Quantized weights must have 8 or 16 bits" << endl;
+        options.quantizedBits = 0;
+      }
+    } else if (strcmp(arg, "-validate-quantized") == 0) {
+      options.validateQuantized = true;
+    } else if (strcmp(arg, "-bench") == 0 && hasValue) {
+      options.benchTicks = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-seed") == 0 && hasValue) {
+      options.seed = atol(argv[++i]);
+    } else if (strcmp(arg, "-generations") == 0 && hasValue) {
+      options.generations = max(0, atoi(argv[++i]));
+    } else if (strcmp(arg, "-sense-every") == 0 && hasValue) {
+      options.senseEvery = max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "-sense-adaptive") == 0) {
+      options.senseAdaptive = true;
+    } else if (strcmp(arg, "-verify-record") == 0 && hasValue) {
+      options.verifyRecordPath = argv[++i];
+    } else if (strcmp(arg, "-verify") == 0 && hasValue) {
+      options.verifyPath = argv[++i];
+    } else if (strcmp(arg, "-verify-tolerance") == 0 && hasValue) {
+      options.verifyTolerance = fmax(0.0, atof(argv[++i]));
+    } else if (strcmp(arg, "-food-regrowth") == 0 && hasValue) {
+      options.foodRegrowth = fmax(0.0, fmin(1.0, atof(argv[++i])));
+    } else if (strcmp(arg, "-steady-state") == 0) {
+      options.steadyState = true;
+    } else {
+      cerr << "Unknown option: " << arg << endl;
+    }
+  }
+
+  // breeding a few fish at a time from mostly unfed retirees, rank
+  // selection barely favours the ones that ate, tournaments do
+  if (options.steadyState && !selectionChosen) {
+    options.selection.strategy = SELECTION_TOURNAMENT;
+  }
+  // replays and brain traces follow a fish by its index, which a
+  // steady state pond hands to a new fish whenever one retires
+  if (options.steadyState && !options.recordPath.empty()) {
+    cerr << "-record does not work with -steady-state" << endl;
+    options.recordPath.clear();
+  }
+  if (options.steadyState && !options.exportPath.empty()) {
+    cerr << "-export does not work with -steady-state" << endl;
+    options.exportPath.clear();
+  }
+  // retirees are bred one by one with the genetic operators, and
+  // novelty is scored over whole generations
+  if (options.steadyState && options.optimizer != OPTIMIZER_GENETIC) {
+    cerr << "-optimizer es and cmaes do not work with -steady-state" << endl;
+    options.optimizer = OPTIMIZER_GENETIC;
+  }
+  if (options.steadyState && options.noveltyWeight > 0) {
+    cerr << "-novelty does not work with -steady-state" << endl;
+    options.noveltyWeight = 0.f;
+  }
+}
+
+#endif
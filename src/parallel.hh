@@ -0,0 +1,109 @@
+#ifndef parallel_h
+#define parallel_h
+
+#include "options.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+using Job = function<void(size_t begin, size_t end)>;
+
+// Fixed set of threads that split index ranges between them.
+// The calling thread takes part in every job, so a pool of size 1
+// runs everything inline. Jobs must not start nested jobs.
+class WorkerPool {
+private:
+  vector<thread> threads;
+  mutex lock;
+  condition_variable wake;
+  condition_variable done;
+  const Job* job = nullptr;
+  size_t jobSize = 0;
+  size_t grainSize = 1;
+  atomic<size_t> nextIndex;
+  unsigned pending = 0;
+  unsigned generation = 0;
+  bool stopping = false;
+
+  void runSlices() {
+    size_t begin;
+    while ((begin = nextIndex.fetch_add(grainSize)) < jobSize) {
+      (*job)(begin, min(begin + grainSize, jobSize));
+    }
+  }
+
+  void workerLoop() {
+    unsigned seen = 0;
+    while (true) {
+      {
+        unique_lock<mutex> guard(lock);
+        wake.wait(guard, [&] { return stopping || generation != seen; });
+        if (stopping) { return; }
+        seen = generation;
+      }
+      runSlices();
+      {
+        lock_guard<mutex> guard(lock);
+        if (--pending == 0) { done.notify_one(); }
+      }
+    }
+  }
+
+public:
+  WorkerPool(unsigned numThreads): nextIndex(0) {
+    for (unsigned i = 1; i < numThreads; i++) {
+      threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+  }
+
+  ~WorkerPool() {
+    {
+      lock_guard<mutex> guard(lock);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads) { t.join(); }
+  }
+
+  unsigned size() const {
+    return threads.size() + 1;
+  }
+
+  // calls fn(begin, end) over slices of [0, count) and blocks until all are done
+  void parallelFor(size_t count, const Job& fn, size_t grain = 0) {
+    if (count == 0) { return; }
+    if (threads.empty() || count == 1) {
+      fn(0, count);
+      return;
+    }
+    {
+      lock_guard<mutex> guard(lock);
+      job = &fn;
+      jobSize = count;
+      grainSize = grain > 0 ? grain : max<size_t>(1, count / (size() * 4));
+      nextIndex = 0;
+      pending = threads.size();
+      generation++;
+    }
+    wake.notify_all();
+    runSlices();
+    unique_lock<mutex> guard(lock);
+    done.wait(guard, [&] { return pending == 0; });
+  }
+};
+
+WorkerPool& workers() {
+  static WorkerPool pool(
+    options.threads > 0 ? options.threads : max(1u, thread::hardware_concurrency())
+  );
+  return pool;
+}
+
+#endif
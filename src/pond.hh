@@ -5,27 +5,57 @@
 #include "math.hh"
 #include "genetics.hh"
 #include "network.hh"
-
+#include "export.hh"
+#include "novelty.hh"
+#include "optimizer.hh"
+#include "parallel.hh"
+#include "quantized.hh"
+#include "spatial.hh"
+
+#include <atomic>
+#include <memory>
 #include <vector>
 
 using namespace std;
 
-const int WORLD_SIZE = 3000;
-const int WORLD_CHUNKS = 10;
+// sizes that bench.sh overrides at compile time with -D
+#ifndef NEATPOND_WORLD_SIZE
+#define NEATPOND_WORLD_SIZE 3000
+#endif
+#ifndef NEATPOND_FISH_AMOUNT
+#define NEATPOND_FISH_AMOUNT 150
+#endif
+#ifndef NEATPOND_FOOD_AMOUNT
+#define NEATPOND_FOOD_AMOUNT 150
+#endif
+#ifndef NEATPOND_FISH_NUM_EYES
+#define NEATPOND_FISH_NUM_EYES 10
+#endif
+
+const int WORLD_SIZE = NEATPOND_WORLD_SIZE;
+// chunks are about as wide as a fish can see
+const int WORLD_CHUNKS = max(1, WORLD_SIZE / 300);
 const int GRID_SIZE = WORLD_SIZE / WORLD_CHUNKS;
 const int GENERATION_LIFESPAN = 500;
-const int FISH_AMOUNT = 150;
+const int FISH_AMOUNT = NEATPOND_FISH_AMOUNT;
 const float FISH_MAX_SPEED = 5.0;
 const float MAX_ENERGY = 200;
 const float ENERGY_INCREASE = 50;
-const int FISH_NUM_EYES = 10;
+const int FISH_NUM_EYES = NEATPOND_FISH_NUM_EYES;
 const int MAX_FOOD_PER_CHUNK = 20;
-const int FOOD_AMOUNT = 150;
+const int FOOD_AMOUNT = NEATPOND_FOOD_AMOUNT;
 const float FOOD_RESPAWN_RATE = 0.75;
 const float FOOD_EAT_DIFFICULTY = 0.0;
 const float MUTATION_RATE = 0.005;
 const int HIDDEN_LAYERS = 1;
 const int HIDDEN_NODES = 2;
+// how far a fish senses other fish, also the cell size of the fish grid
+const float FISH_SENSE_RADIUS = 100;
+// neighbours within the radius that saturate the density sensor
+const int FISH_DENSITY_SATURATION = 8;
+// positions sampled over a lifetime to describe a fish's behaviour
+const int BEHAVIOR_SAMPLES = 4;
+const int BEHAVIOR_SIZE = BEHAVIOR_SAMPLES * 2;
 
 enum {
   INPUT_SENSOR_FIRST,
@@ -35,6 +65,9 @@ enum {
   INPUT_ENERGY,
   INPUT_CLOCK_1,
   INPUT_CLOCK_2,
+  INPUT_FISH_DISTANCE,
+  INPUT_FISH_BEARING,
+  INPUT_FISH_DENSITY,
   NUM_INPUTS
 };
 
@@ -67,13 +100,20 @@ const int DNA_LENGTH =
   ((HIDDEN_NODES + 1) * NUM_OUTPUTS) +
   ((HIDDEN_NODES + 1) * HIDDEN_NODES * (HIDDEN_LAYERS - 1));
 
+using Behavior = array<float, BEHAVIOR_SIZE>;
+
 struct Food {
   Vector2D position;
   bool eaten = false;
+  // stays the same while the food moves between chunks, see addFood()
+  int id = -1;
 };
 
 struct Fish : Genome {
+  // with -quantized the fixed point brain is the only one, and brain
+  // stays empty, see buildNetwork()
   Network brain;
+  QuantizedNetwork quantizedBrain;
 
   vector<double> input;
   vector<double> output;
@@ -90,18 +130,16 @@ struct Fish : Genome {
   float clock = 0.f;
   float energy = 1000.f;
   bool dead = false;
-
-  ~Fish() { }
-
-  Fish(DNA genes):
-    Genome(genes),
-    brain({NUM_INPUTS, HIDDEN_NODES, NUM_OUTPUTS})
-  {
-    vector<double> weightGenes(
-      genes.cbegin() + NUM_TRAITS,
-      genes.cend()
-    );
-    brain.setWeights(weightGenes);
+  Behavior behavior;
+  // novelty of the behaviour relative to the best of its generation
+  float novelty = 0.f;
+
+  Fish(DNA genes): Genome(genes) {
+    if (options.quantizedBits != 0) {
+      quantizedBrain = QuantizedNetwork(buildNetwork(), options.quantizedBits);
+    } else {
+      brain = buildNetwork();
+    }
     fov = genes[TRAIT_FOV] * M_PI;
     for (int i = NUM_INPUTS; i--;) {
       input.push_back(0.0);
@@ -111,19 +149,57 @@ struct Fish : Genome {
     }
   }
 
-  float fitness() const override {
+  // the double precision brain of the genes
+  Network buildNetwork() const {
+    return networkOf(genes);
+  }
+
+  static Network networkOf(const DNA& genes) {
+    Network network({NUM_INPUTS, HIDDEN_NODES, NUM_OUTPUTS});
+    vector<double> weightGenes(
+      genes.cbegin() + NUM_TRAITS,
+      genes.cend()
+    );
+    network.setWeights(weightGenes);
+    return network;
+  }
+
+  // the brain with the activations of the current inputs, for drawing
+  Network activeNetwork() const {
+    if (quantizedBrain.empty()) { return brain; }
+    auto network = buildNetwork();
+    auto currentInput = input;
+    network.feedForward(currentInput);
+    return network;
+  }
+
+  float foodFitness() const {
     float foodFitness = foodCollected / float(FOOD_AMOUNT);
     float fitness = powf(foodFitness, 2);
     return fitness;
   }
 
+  float fitness() const override {
+    float weight = options.noveltyWeight;
+    return (1 - weight) * foodFitness() + weight * novelty;
+  }
+
   void reset() override {
-    int location = genes[TRAIT_BIRTH_LOCATION] * (WORLD_SIZE * WORLD_SIZE);
+    long location = genes[TRAIT_BIRTH_LOCATION] * (long(WORLD_SIZE) * WORLD_SIZE);
     angle = RANDOM_NUM * M_PI * 2;
     position.x = location % WORLD_SIZE;
     position.y = floor(location / WORLD_SIZE);
     foodCollected = 0;
     clock = 0.f;
+    // elites live on into the next generation, so start them afresh
+    velocity = Vector2D();
+    speed = 0.f;
+    turnSpeed = 0.f;
+    energy = 1000.f;
+    dead = false;
+    novelty = 0.f;
+    fill(input.begin(), input.end(), 0.0);
+    recordBehavior();
   }
 
   bool eat() {
@@ -136,10 +212,24 @@ struct Fish : Genome {
   }
 
   void update() override {
+    think();
+    swim();
+  }
+
+  // runs the brain on the inputs
+  void think() {
     if (dead) { return; }
-    brain.feedForward(input);
-    brain.getResults(output);
+    if (!quantizedBrain.empty()) {
+      quantizedBrain.feedForward(input, output);
+    } else {
+      brain.feedForward(input);
+      brain.getResults(output);
+    }
+  }
 
+  // steers and moves by the outputs
+  void swim() {
+    if (dead) { return; }
     float targetTurnSpeed = output[OUTPUT_DIRECTION] * 2.0 - 1.0;
     float targetSpeed = output[OUTPUT_SPEED] * FISH_MAX_SPEED;
     float acc = targetSpeed >= speed ? 1 : 0.05;
@@ -161,11 +251,23 @@ struct Fish : Genome {
     if (position.y < 0) { position.y = WORLD_SIZE; }
     if (position.x > WORLD_SIZE) { position.x = 0; }
     if (position.y > WORLD_SIZE) { position.y = 0; }
+    recordBehavior();
     if (energy <= 0.0) {
       dead = true;
     }
   }
 
+  // keeps writing the position into the current and all later samples,
+  // so each sample ends up with the position at the end of its interval
+  // and a dead fish keeps the place it died at
+  void recordBehavior() {
+    int sample = min(BEHAVIOR_SAMPLES - 1, int(clock) * BEHAVIOR_SAMPLES / GENERATION_LIFESPAN);
+    for (int s = sample; s < BEHAVIOR_SAMPLES; s++) {
+      behavior[s * 2] = position.x / WORLD_SIZE;
+      behavior[s * 2 + 1] = position.y / WORLD_SIZE;
+    }
+  }
+
   float foodSensorStrength(int sensor, const Food& food) const {
     float maxStrength = 0.f;
     float sensorAngle = angle + (-FISH_NUM_EYES / 2 + sensor) * (fov / float(FISH_NUM_EYES));
@@ -193,18 +295,36 @@ struct Fish : Genome {
     return false;
   }
 
-  void perceive(const vector<Food>& foods) {
+  // whether the food sensors are refreshed this tick. Fish are split
+  // into options.senseEvery cohorts by index, refreshed on staggered
+  // ticks; adaptive sensing shortens the interval as food gets close.
+  bool senseDue(int index) const {
+    int every = options.senseEvery;
+    if (options.senseAdaptive) {
+      auto eyes = input.begin() + INPUT_SENSOR_FIRST;
+      float nearest = *max_element(eyes, eyes + FISH_NUM_EYES);
+      every = max(1, int(lround(every * (1 - nearest))));
+    }
+    return every <= 1 || clock == 0 || (int(clock) + index) % every == 0;
+  }
+
+  // forEachFood(fn) calls fn with every food that may be in sight. The
+  // food sensors keep their last values when refreshFood is false.
+  template<class F>
+  void perceive(F forEachFood, bool refreshFood = true) {
     if (dead) { return; }
 
-    for (int sensor = 0; sensor < FISH_NUM_EYES; sensor++) {
-      float maxStrength = 0.0;
-      for (auto& food : foods) {
-        float strength = foodSensorStrength(sensor, food);
-        if (strength > maxStrength) {
-          maxStrength = strength;
+    if (refreshFood) {
+      auto eyes = input.begin() + INPUT_SENSOR_FIRST;
+      fill(eyes, eyes + FISH_NUM_EYES, 0.0);
+      forEachFood([&](const Food& food) {
+        for (int sensor = 0; sensor < FISH_NUM_EYES; sensor++) {
+          float strength = foodSensorStrength(sensor, food);
+          if (strength > eyes[sensor]) {
+            eyes[sensor] = strength;
+          }
         }
-      }
-      input[INPUT_SENSOR_FIRST + sensor] = maxStrength;
+      });
     }
 
     input[INPUT_DIRECTION] = modAngle(angle) / (M_PI * 2);
@@ -213,65 +333,539 @@ struct Fish : Genome {
     input[INPUT_CLOCK_1] = fmod(clock * genes[TRAIT_CLOCK_SPEED], 1.0);
     input[INPUT_CLOCK_2] = fmod(clock * genes[TRAIT_CLOCK_SPEED_2], (float)GENERATION_LIFESPAN) / (float)GENERATION_LIFESPAN;
   }
+
+  // senses the nearest living fish and how crowded it is around, id is
+  // this fish's own entry in the grid
+  void perceiveFish(const SpatialGrid& fishGrid, int id) {
+    if (dead) { return; }
+
+    float nearest = FISH_SENSE_RADIUS * FISH_SENSE_RADIUS;
+    float nearestX = 0.f;
+    float nearestY = 0.f;
+    int neighbours = 0;
+    fishGrid.query(position.x, position.y, FISH_SENSE_RADIUS, [&](const SpatialGrid::Entry& other) {
+      if (other.id == id || other.dead) { return; }
+      float dx = other.x - position.x;
+      float dy = other.y - position.y;
+      float dist = dx * dx + dy * dy;
+      if (dist >= FISH_SENSE_RADIUS * FISH_SENSE_RADIUS) { return; }
+      neighbours++;
+      if (dist < nearest) {
+        nearest = dist;
+        nearestX = dx;
+        nearestY = dy;
+      }
+    });
+
+    if (neighbours > 0) {
+      input[INPUT_FISH_DISTANCE] = 1 - sqrtf(nearest) / FISH_SENSE_RADIUS;
+      input[INPUT_FISH_BEARING] = modAngle(atan2f(nearestY, nearestX) - angle) / (M_PI * 2);
+    } else {
+      input[INPUT_FISH_DISTANCE] = 0.0;
+      input[INPUT_FISH_BEARING] = 0.0;
+    }
+    input[INPUT_FISH_DENSITY] = fmin(1.0, neighbours / float(FISH_DENSITY_SATURATION));
+  }
+};
+
+// Square of the world that holds the food lying in it. Chunks out of
+// sight of every fish are dormant: no per tick work touches them, and
+// when a fish comes close advanceChunk() catches up on the ticks they
+// slept through in one step.
+struct Chunk {
+  vector<Food> foods;
+  // tick the chunk has been advanced to
+  long tick = 0;
+  bool awake = false;
 };
 
 class NeatPond {
 private:
   Population<Fish> population;
-  vector<Food> foods;
+  vector<Chunk> chunks;
+  // chunks within sight of a living fish this tick
+  vector<int> awakeChunks;
+  long tick = 0;
+  // the food of all chunks, gathered by getFood() when asked for
+  mutable vector<Food> allFoods;
+  mutable bool allFoodsValid = false;
+  int nextFoodId = 0;
+  // chunk and index of the food within reach of each fish's mouth,
+  // filled by move()
+  vector<vector<pair<int, int>>> bites;
+  unique_ptr<Optimizer<Fish>> optimizer;
+  unique_ptr<NoveltySearch<BEHAVIOR_SIZE>> noveltySearch;
+  // fixed opponents that take part in every generation but never breed
+  vector<Fish> champions;
+  float championFitness = 0.f;
+  // steady state evolution, the genes and lifetime fitness of the
+  // last fish retired
+  SlidingWindow<pair<DNA, float>> retirees;
+  SlidingWindow<float> retiredChampions;
+  bool populated = false;
+  // fish that died this tick, in any order since swim() runs on
+  // several threads
+  vector<int> deaths;
+  atomic<int> numDeaths{0};
+  // fish that outlive GENERATION_LIFESPAN at tick t are queued in
+  // expiries[t % expiries.size()], with the life they were queued for
+  vector<vector<pair<int, int>>> expiries;
+  vector<int> lives;
+  // fish positions as of the end of the last tick, see indexFishes()
+  SpatialGrid fishGrid;
+  vector<SpatialGrid::Entry> fishPoints;
+
+  static float mouthDistance(const Fish& fish, const Food& food) {
+    float mouthX = fish.position.x + cosf(fish.angle) * 8.f;
+    float mouthY = fish.position.y + sinf(fish.angle) * 8.f;
+    float distX = mouthX - food.position.x;
+    float distY = mouthY - food.position.y;
+    return sqrt(distX * distX + distY * distY);
+  }
+
+  static int chunkCoordinate(float value) {
+    return max(0, min(WORLD_CHUNKS - 1, int(floorf(value / GRID_SIZE))));
+  }
+
+  static int chunkAt(Vector2D position) {
+    return chunkCoordinate(position.y) * WORLD_CHUNKS + chunkCoordinate(position.x);
+  }
+
+  // calls fn(chunk) for the chunks overlapping the square of half size
+  // radius around position
+  template<class F>
+  static void forChunksNear(Vector2D position, float radius, F fn) {
+    int left = chunkCoordinate(position.x - radius);
+    int right = chunkCoordinate(position.x + radius);
+    int top = chunkCoordinate(position.y - radius);
+    int bottom = chunkCoordinate(position.y + radius);
+    for (int y = top; y <= bottom; y++) {
+      for (int x = left; x <= right; x++) {
+        fn(y * WORLD_CHUNKS + x);
+      }
+    }
+  }
+
+  // new food, with an id of -1, gets the next free one
+  void addFood(const Food& food) {
+    auto& foods = chunks[chunkAt(food.position)].foods;
+    foods.push_back(food);
+    if (food.id < 0) { foods.back().id = nextFoodId++; }
+    allFoodsValid = false;
+  }
+
+  // regrows the food of a chunk over the ticks since it was last
+  // advanced. Every tick grows one food with probability
+  // options.foodRegrowth, so the ticks between two growths are
+  // geometrically distributed and can be skipped over in one draw.
+  void advanceChunk(int c) {
+    auto& chunk = chunks[c];
+    long elapsed = tick - chunk.tick;
+    chunk.tick = tick;
+    float rate = options.foodRegrowth;
+    if (rate <= 0 || elapsed <= 0) { return; }
+
+    Vector2D corner((c % WORLD_CHUNKS) * GRID_SIZE, (c / WORLD_CHUNKS) * GRID_SIZE);
+    long grown = 0;
+    while (chunk.foods.size() < MAX_FOOD_PER_CHUNK) {
+      double uniform = (rand() + 1.0) / (RAND_MAX + 1.0);
+      grown += rate >= 1 ? 1 : 1 + long(log(uniform) / log(1.0 - rate));
+      if (grown > elapsed) { break; }
+      Vector2D offset(RANDOM_NUM * GRID_SIZE, RANDOM_NUM * GRID_SIZE);
+      chunk.foods.push_back({ corner + offset, false, nextFoodId++ });
+      allFoodsValid = false;
+    }
+  }
+
+  // wakes and advances the chunks within sight of a living fish, all
+  // others stay dormant
+  void wakeChunks() {
+    for (auto c : awakeChunks) {
+      chunks[c].awake = false;
+    }
+    awakeChunks.clear();
+    for (int i = 0; i < numFishes(); i++) {
+      auto& fish = fishAt(i);
+      if (fish.dead) { continue; }
+      forChunksNear(fish.position, fish.sightLength, [&](int c) {
+        if (chunks[c].awake) { return; }
+        chunks[c].awake = true;
+        awakeChunks.push_back(c);
+        advanceChunk(c);
+      });
+    }
+  }
+
+  // moves food that was relocated this tick into its new chunk and
+  // drops the food that was eaten for good
+  void sortFood(vector<int>& touched) {
+    if (touched.empty()) { return; }
+    // food was moved in place or eaten, which getFood() has not seen
+    allFoodsValid = false;
+    sort(touched.begin(), touched.end());
+    touched.erase(unique(touched.begin(), touched.end()), touched.end());
+    vector<Food> moved;
+    for (auto c : touched) {
+      auto& foods = chunks[c].foods;
+      auto kept = foods.begin();
+      for (auto& food : foods) {
+        if (food.eaten) { continue; }
+        if (chunkAt(food.position) != c) {
+          moved.push_back(food);
+        } else {
+          *kept++ = food;
+        }
+      }
+      foods.erase(kept, foods.end());
+    }
+    for (auto& food : moved) {
+      addFood(food);
+    }
+  }
 
 public:
-  NeatPond(): population(FISH_AMOUNT, DNA_LENGTH) {
+  NeatPond():
+    population(FISH_AMOUNT, DNA_LENGTH),
+    chunks(WORLD_CHUNKS * WORLD_CHUNKS),
+    optimizer(makeOptimizer<Fish>(MUTATION_RATE)),
+    retirees(FISH_AMOUNT),
+    retiredChampions(max<size_t>(1, options.championPaths.size())),
+    fishGrid(WORLD_SIZE, FISH_SENSE_RADIUS)
+  {
+    population.selection = options.selection;
+    if (options.noveltyWeight > 0) {
+      noveltySearch.reset(new NoveltySearch<BEHAVIOR_SIZE>(options.noveltyNeighbours));
+    }
+    for (auto& path : options.championPaths) {
+      DNA genes;
+      if (loadChampion(path, genes) && genes.size() == DNA_LENGTH) {
+        champions.push_back(Fish(genes));
+      } else {
+        cerr << "Champion " << path << " does not fit this pond" << endl;
+      }
+    }
     reset();
+    if (options.steadyState) {
+      // staggered ages spread the first retirements over a lifespan
+      auto& fishes = population.genomes;
+      for (auto& fish : fishes) {
+        fish.clock = floor(RANDOM_NUM * GENERATION_LIFESPAN);
+      }
+      deaths.resize(fishes.size());
+      expiries.resize(GENERATION_LIFESPAN + 2);
+      lives.assign(fishes.size(), 0);
+      for (int i = 0; i < fishes.size(); i++) {
+        scheduleExpiry(i, tick);
+      }
+    }
   }
 
   const vector<Food>& getFood() const {
-    return foods;
+    if (!allFoodsValid) {
+      allFoods.clear();
+      for (auto& chunk : chunks) {
+        allFoods.insert(allFoods.end(), chunk.foods.begin(), chunk.foods.end());
+      }
+      allFoodsValid = true;
+    }
+    return allFoods;
   };
 
+  // calls fn(food) for the food of every chunk, without gathering it
+  template<class F>
+  void forFood(F fn) const {
+    for (auto& chunk : chunks) {
+      for (auto& food : chunk.foods) {
+        fn(food);
+      }
+    }
+  }
+
+  size_t numAwakeChunks() const {
+    return awakeChunks.size();
+  }
+
+  bool isChunkAwake(int x, int y) const {
+    return chunks[y * WORLD_CHUNKS + x].awake;
+  }
+
   const vector<Fish>& getFishes() const {
     return population.genomes;
   };
 
+  const vector<Fish>& getChampions() const {
+    return champions;
+  };
+
+  // average fitness of the champions over the last generation
+  float getChampionFitness() const {
+    return championFitness;
+  }
+
   void spawnFood(Vector2D position) {
     int amount = 1 + RANDOM_NUM * 4;
     for (int i = 0; i < amount; i++) {
       Vector2D offset(-64 + RANDOM_NUM * 32, -64 + RANDOM_NUM * 32);
-      foods.push_back({ position + offset });
+      addFood({ position + offset });
     }
   }
 
-  void update() {
-    for (auto& fish : population.genomes) {
-      fish.perceive(foods);
-      fish.update();
+  // the population followed by the champions
+  size_t numFishes() const {
+    return population.genomes.size() + champions.size();
+  }
 
-      for (auto& food : foods) {
-        float mouthX = fish.position.x + cosf(fish.angle) * 8.f;
-        float mouthY = fish.position.y + sinf(fish.angle) * 8.f;
-        float distX = mouthX - food.position.x;
-        float distY = mouthY - food.position.y;
-        float distance = sqrt(distX * distX + distY * distY);
-        if (distance <= 16 && bool(RANDOM_NUM > FOOD_EAT_DIFFICULTY)) {
+  Fish& fishAt(size_t i) {
+    auto size = population.genomes.size();
+    return i < size ? population.genomes[i] : champions[i - size];
+  }
+
+  // rebuilds the fish grid, done serially after every tick so moving
+  // fishes only ever read the grid's own copy of the positions
+  void indexFishes() {
+    fishPoints.resize(numFishes());
+    workers().parallelFor(fishPoints.size(), [this](size_t begin, size_t end) {
+      for (auto i = begin; i < end; i++) {
+        auto& fish = fishAt(i);
+        fishPoints[i] = {fish.position.x, fish.position.y, int(i), fish.dead};
+      }
+    });
+    fishGrid.build(fishPoints);
+  }
+
+  const SpatialGrid& getFishGrid() const {
+    return fishGrid;
+  }
+
+  // index of the population fish nearest to position within a square of
+  // half size radius, -1 when there is none
+  int pickFish(Vector2D position, float radius) const {
+    int picked = -1;
+    float best = INFINITY;
+    fishGrid.query(position.x, position.y, radius, [&](const SpatialGrid::Entry& fish) {
+      float dx = fish.x - position.x;
+      float dy = fish.y - position.y;
+      if (fish.id >= population.genomes.size() || fabs(dx) >= radius || fabs(dy) >= radius) { return; }
+      if (dx * dx + dy * dy < best) {
+        best = dx * dx + dy * dy;
+        picked = fish.id;
+      }
+    });
+    return picked;
+  }
+
+  // runs fn(i) for every fish on the workers
+  template<class F>
+  void forFishes(F fn) {
+    workers().parallelFor(numFishes(), [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; i++) { fn(i); }
+    });
+  }
+
+  // The stages of moving fish i. A fish only reads food and the fish
+  // grid, which stay put until feed(), so running each stage over all
+  // fishes before the next gives the same pond as moveFish().
+  void senseFood(int i) {
+    auto& fish = fishAt(i);
+    auto forEachFood = [&](auto fn) {
+      forChunksNear(fish.position, fish.sightLength, [&](int c) {
+        for (auto& food : chunks[c].foods) { fn(food); }
+      });
+    };
+    fish.perceive(forEachFood, fish.senseDue(i));
+  }
+
+  void senseFish(int i) {
+    fishAt(i).perceiveFish(fishGrid, i);
+  }
+
+  void think(int i) {
+    fishAt(i).think();
+  }
+
+  // moves fish i and finds the food in reach of its mouth
+  void swim(int i) {
+    auto& fish = fishAt(i);
+    auto& reach = bites[i];
+    bool wasDead = fish.dead;
+    fish.swim();
+    if (options.steadyState && !wasDead && fish.dead && i < population.genomes.size()) {
+      deaths[numDeaths++] = i;
+    }
+
+    reach.clear();
+    if (fish.dead) { return; }
+    forChunksNear(fish.position, 8 + 16, [&](int c) {
+      auto& foods = chunks[c].foods;
+      for (int f = 0; f < foods.size(); f++) {
+        if (mouthDistance(fish, foods[f]) <= 16) {
+          reach.push_back({c, f});
+        }
+      }
+    });
+  }
+
+  // perceives and moves a fish, safe to call for different fish from
+  // several threads since it only reads the food and grid. Fish only
+  // look at the chunks around them, which wakeChunks() made sure are
+  // awake and up to date.
+  void moveFish(int i) {
+    senseFood(i);
+    senseFish(i);
+    think(i);
+    swim(i);
+  }
+
+  // moves fishes [begin, end)
+  void move(size_t begin, size_t end) {
+    for (auto i = begin; i < end; i++) {
+      moveFish(i);
+    }
+  }
+
+  // lets every fish eat the food found in reach by move()
+  void feed() {
+    vector<int> touched;
+    for (int i = 0; i < numFishes(); i++) {
+      auto& fish = fishAt(i);
+      for (auto bite : bites[i]) {
+        auto& food = chunks[bite.first].foods[bite.second];
+        // an earlier fish may have eaten it this tick
+        if (mouthDistance(fish, food) <= 16 && bool(RANDOM_NUM > FOOD_EAT_DIFFICULTY)) {
           if (fish.eat()) {
-            food.eaten = bool(RANDOM_NUM > FOOD_RESPAWN_RATE);
+            // without generations nothing restocks food, so it always respawns
+            food.eaten = !options.steadyState && bool(RANDOM_NUM > FOOD_RESPAWN_RATE);
             food.position.x = RANDOM_NUM * WORLD_SIZE;
             food.position.y = RANDOM_NUM * WORLD_SIZE;
+            touched.push_back(bite.first);
           }
         }
       }
     }
 
-    foods.erase(
-      remove_if(begin(foods), end(foods),
-      [](Food& food) { return food.eaten; }),
-      end(foods)
-    );
+    sortFood(touched);
+    if (options.steadyState) {
+      replaceRetired();
+    }
+    tick++;
+    wakeChunks();
+    indexFishes();
+  }
+
+  // Every fish moves on its own and feed() settles the bites in fish
+  // order, so the pond is the same on any number of threads.
+  void update() {
+    forFishes([this](int i) { moveFish(i); });
+    feed();
+  }
+
+  // scores the novelty of every fish, scaled so the most novel one gets 1
+  void evaluateNovelty() {
+    auto& fishes = population.genomes;
+    vector<Behavior> behaviors;
+    for (auto& fish : fishes) {
+      behaviors.push_back(fish.behavior);
+    }
+    auto novelty = noveltySearch->evaluate(behaviors);
+    float maxNovelty = novelty.empty() ? 0.f : *max_element(novelty.begin(), novelty.end());
+    for (int i = 0; i < fishes.size(); i++) {
+      fishes[i].novelty = maxNovelty > 0 ? novelty[i] / maxNovelty : 0.f;
+    }
+  }
+
+  // rtNEAT style steady state evolution: fish that died or outlived
+  // GENERATION_LIFESPAN make way for offspring right away. Parents are
+  // picked by food fitness among the lives that ended most recently,
+  // which are whole lives and compare fairly, unlike the fish still
+  // alive. Those would favour fish that sit still and never starve.
+  void replaceRetired() {
+    auto& fishes = population.genomes;
+    vector<int> retired(deaths.begin(), deaths.begin() + numDeaths);
+    numDeaths = 0;
+    auto& expiring = expiries[tick % expiries.size()];
+    for (auto expiry : expiring) {
+      auto i = expiry.first;
+      // replaced since, or already retired by its death
+      if (expiry.second != lives[i] || fishes[i].dead) { continue; }
+      if (fishes[i].clock > GENERATION_LIFESPAN) {
+        retired.push_back(i);
+      } else {
+        scheduleExpiry(i, tick + 1);
+      }
+    }
+    expiring.clear();
+    // in index order, whichever thread saw the death first
+    sort(retired.begin(), retired.end());
+    for (auto i : retired) {
+      retirees.push({fishes[i].genes, fishes[i].foodFitness()});
+    }
+
+    for (auto& champion : champions) {
+      if (champion.dead || champion.clock > GENERATION_LIFESPAN) {
+        retiredChampions.push(champion.foodFitness());
+        champion.reset();
+      }
+    }
+    if (retired.empty()) { return; }
+
+    vector<const DNA*> candidates;
+    vector<float> fitnesses;
+    for (auto& retiree : retirees.getValues()) {
+      candidates.push_back(&retiree.first);
+      fitnesses.push_back(retiree.second);
+    }
+    population.replace(retired, candidates, fitnesses, MUTATION_RATE);
+    for (auto i : retired) {
+      fishes[i].reset();
+      lives[i]++;
+      scheduleExpiry(i, tick + 1);
+    }
+  }
+
+  // queues fish i to retire once it outlives GENERATION_LIFESPAN, when
+  // it moves next at firstTick and then every tick after
+  void scheduleExpiry(int i, long firstTick) {
+    auto& fish = population.genomes[i];
+    long expiry = firstTick + max(0, GENERATION_LIFESPAN - int(fish.clock));
+    expiries[expiry % expiries.size()].push_back({i, lives[i]});
   }
 
   float reset() {
-    auto fitness = population.reproduce(population.genomes, MUTATION_RATE);
-    foods.clear();
+    if (options.steadyState && populated) {
+      // there are no generations to end, report the sliding window
+      auto mean = [](const vector<float>& values) {
+        float sum = 0.f;
+        for (auto value : values) { sum += value; }
+        return values.empty() ? 0.f : sum / values.size();
+      };
+      vector<float> fitnesses;
+      for (auto& retiree : retirees.getValues()) {
+        fitnesses.push_back(retiree.second);
+      }
+      championFitness = mean(retiredChampions.getValues());
+      return mean(fitnesses);
+    }
+    populated = true;
+
+    // the reported fitness stays the food fitness when novelty is mixed in
+    float foodFitness = 0.f;
+    if (noveltySearch) {
+      evaluateNovelty();
+      for (auto& fish : population.genomes) {
+        foodFitness += fish.foodFitness() / population.genomes.size();
+      }
+    }
+
+    auto fitness = optimizer->step(population);
+    if (noveltySearch) {
+      fitness = foodFitness;
+    }
+    for (auto& chunk : chunks) {
+      chunk.foods.clear();
+      chunk.tick = tick;
+    }
+    allFoodsValid = false;
+    nextFoodId = 0;
     for (int i = FOOD_AMOUNT; i--;) {
       spawnFood({
         float(RANDOM_NUM * WORLD_SIZE),
@@ -279,7 +873,16 @@ public:
       });
     }
 
+    championFitness = 0.f;
+    for (auto& champion : champions) {
+      championFitness += champion.foodFitness() / champions.size();
+      champion.reset();
+    }
+
     population.reset();
+    bites.resize(numFishes());
+    wakeChunks();
+    indexFishes();
     return fitness;
   }
 };
@@ -0,0 +1,228 @@
+#ifndef quantized_h
+#define quantized_h
+
+#include "network.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Activations are fixed point with ACTIVATION_BITS fraction bits. With
+// 16 bit weights a product needs at most 25 bits, so the 32 bit sums
+// cannot overflow for layers of up to 64 inputs.
+const int ACTIVATION_BITS = 10;
+const int ACTIVATION_ONE = 1 << ACTIVATION_BITS;
+const int QUANTIZED_MAX_INPUTS = 64;
+const int SIGMOID_TABLE_SIZE = 4096;
+const double SIGMOID_TABLE_RANGE = 16.0;
+const int MULTIPLIER_SHIFT = 24;
+
+struct SigmoidTable {
+  int16_t values[SIGMOID_TABLE_SIZE];
+
+  SigmoidTable() {
+    double step = 2 * SIGMOID_TABLE_RANGE / SIGMOID_TABLE_SIZE;
+    for (int i = 0; i < SIGMOID_TABLE_SIZE; i++) {
+      double x = (i + 0.5 - SIGMOID_TABLE_SIZE / 2) * step;
+      values[i] = lround(sigmoid(x) * ACTIVATION_ONE);
+    }
+  }
+};
+
+const SigmoidTable& sigmoidTable() {
+  static SigmoidTable table;
+  return table;
+}
+
+// n must be a multiple of 8
+inline int32_t dotProduct(const int16_t* a, const int16_t* w, int n) {
+#ifdef __SSE2__
+  __m128i sum = _mm_setzero_si128();
+  for (int i = 0; i < n; i += 8) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vw = _mm_loadu_si128((const __m128i*)(w + i));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(va, vw));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+#else
+  int32_t sum = 0;
+  for (int i = 0; i < n; i++) { sum += int32_t(a[i]) * w[i]; }
+  return sum;
+#endif
+}
+
+inline int32_t dotProduct(const int16_t* a, const int8_t* w, int n) {
+#ifdef __SSE2__
+  __m128i sum = _mm_setzero_si128();
+  __m128i zero = _mm_setzero_si128();
+  for (int i = 0; i < n; i += 8) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i bytes = _mm_loadl_epi64((const __m128i*)(w + i));
+    // sign extend to 16 bits by placing the bytes high and shifting down
+    __m128i vw = _mm_srai_epi16(_mm_unpacklo_epi8(zero, bytes), 8);
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(va, vw));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+#else
+  int32_t sum = 0;
+  for (int i = 0; i < n; i++) { sum += int32_t(a[i]) * w[i]; }
+  return sum;
+#endif
+}
+
+// Fixed point copy of a Network with 16 or 8 bit weights, all layers
+// in one buffer. Every layer gets its own scale from the largest weight
+// it holds, and the sigmoid is a lookup table indexed straight from the
+// integer sum. Activations live on the stack, so a network holds
+// nothing but its weights.
+class QuantizedNetwork {
+private:
+  struct QuantizedLayer {
+    // inputs including the bias, rounded up to a multiple of 8
+    int stride;
+    int numOutputs;
+    // maps a raw sum to a sigmoid table index, in 2^-MULTIPLIER_SHIFT
+    int64_t multiplier;
+    // first weight of the layer in weights
+    size_t offset;
+  };
+
+  int bits = 0;
+  vector<QuantizedLayer> layers;
+  // int16_t or int8_t values depending on bits
+  vector<int8_t> weights;
+
+  template<class W>
+  void quantize(const Network& network) {
+    const int maxWeight = numeric_limits<W>::max();
+    auto& source = network.getLayers();
+    vector<W> values;
+
+    for (int l = 1; l < source.size(); l++) {
+      auto& previous = source[l - 1];
+      int numInputs = previous.size();
+      assert(numInputs <= QUANTIZED_MAX_INPUTS);
+
+      QuantizedLayer layer;
+      layer.stride = (numInputs + 7) / 8 * 8;
+      layer.numOutputs = source[l].size() - 1;
+      layer.offset = values.size();
+      assert(layer.numOutputs < QUANTIZED_MAX_INPUTS);
+
+      double maxAbs = 0.0;
+      for (auto& neuron : previous) {
+        for (auto w : neuron.getConnectionWeights()) { maxAbs = fmax(maxAbs, fabs(w)); }
+      }
+      double scale = maxAbs > 0 ? maxAbs / maxWeight : 1.0;
+
+      values.resize(layer.offset + layer.stride * layer.numOutputs, 0);
+      for (int p = 0; p < numInputs; p++) {
+        auto connections = previous[p].getConnectionWeights();
+        for (int n = 0; n < layer.numOutputs; n++) {
+          values[layer.offset + n * layer.stride + p] = lround(connections[n] / scale);
+        }
+      }
+
+      double tableStep = 2 * SIGMOID_TABLE_RANGE / SIGMOID_TABLE_SIZE;
+      layer.multiplier = llround(scale / ACTIVATION_ONE / tableStep * (1LL << MULTIPLIER_SHIFT));
+      layers.push_back(layer);
+    }
+
+    weights.resize(values.size() * sizeof(W));
+    memcpy(weights.data(), values.data(), weights.size());
+    weights.shrink_to_fit();
+    layers.shrink_to_fit();
+  }
+
+  int32_t dot(const int16_t* activations, const QuantizedLayer& layer, int n) const {
+    if (bits == 16) {
+      auto w = (const int16_t*)weights.data() + layer.offset + n * layer.stride;
+      return dotProduct(activations, w, layer.stride);
+    }
+    auto w = weights.data() + layer.offset + n * layer.stride;
+    return dotProduct(activations, w, layer.stride);
+  }
+
+public:
+  QuantizedNetwork() { }
+
+  QuantizedNetwork(const Network& network, int bits): bits(bits) {
+    if (bits == 16) {
+      quantize<int16_t>(network);
+    } else {
+      this->bits = 8;
+      quantize<int8_t>(network);
+    }
+  }
+
+  bool empty() const {
+    return layers.empty();
+  }
+
+  // inputs are expected in [0, 1] like every sensor of a fish
+  void feedForward(const vector<double>& input, vector<double>& output) const {
+    auto& table = sigmoidTable().values;
+    int16_t buffers[2][QUANTIZED_MAX_INPUTS];
+    int16_t* activations = buffers[0];
+    int16_t* nextActivations = buffers[1];
+
+    fill(activations, activations + layers.front().stride, 0);
+    for (int i = 0; i < input.size(); i++) {
+      activations[i] = lround(fmax(0.0, fmin(1.0, input[i])) * ACTIVATION_ONE);
+    }
+    activations[input.size()] = ACTIVATION_ONE;
+
+    for (int l = 0; l < layers.size(); l++) {
+      auto& layer = layers[l];
+      bool last = l == layers.size() - 1;
+      fill(nextActivations, nextActivations + (last ? layer.numOutputs : layers[l + 1].stride), 0);
+
+      for (int n = 0; n < layer.numOutputs; n++) {
+        int32_t sum = dot(activations, layer, n);
+        int64_t index = ((int64_t(sum) * layer.multiplier) >> MULTIPLIER_SHIFT) + SIGMOID_TABLE_SIZE / 2;
+        nextActivations[n] = table[max<int64_t>(0, min<int64_t>(SIGMOID_TABLE_SIZE - 1, index))];
+      }
+      if (!last) {
+        nextActivations[layer.numOutputs] = ACTIVATION_ONE;
+      }
+      swap(activations, nextActivations);
+    }
+
+    output.resize(layers.back().numOutputs);
+    for (int n = 0; n < output.size(); n++) {
+      output[n] = activations[n] / double(ACTIVATION_ONE);
+    }
+  }
+
+  // bytes taken by the weights
+  size_t weightBytes() const {
+    return weights.size();
+  }
+};
+
+// bytes taken by the weights of the double precision network
+size_t weightBytes(const Network& network) {
+  size_t bytes = 0;
+  for (auto& layer : network.getLayers()) {
+    for (auto& neuron : layer) {
+      bytes += neuron.getConnectionWeights().size() * sizeof(double);
+    }
+  }
+  return bytes;
+}
+
+#endif
@@ -0,0 +1,409 @@
+#ifndef replay_h
+#define replay_h
+
+#include "math.hh"
+#include "pond.hh"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Replay files hold recorded generations as blocks of delta encoded
+// frames. Positions are quantized to REPLAY_POSITION_SCALE steps per
+// pixel and angles to REPLAY_ANGLE_STEPS, every value is stored as a
+// zigzag varint relative to the previous frame, so a fish that moves a
+// few pixels per tick costs about three bytes.
+const char REPLAY_MAGIC[4] = { 'N', 'P', 'R', 'P' };
+const int REPLAY_VERSION = 2;
+const int REPLAY_POSITION_SCALE = 4;
+const int REPLAY_ANGLE_STEPS = 1024;
+
+void writeVarint(vector<uint8_t>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(uint8_t(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(uint8_t(value));
+}
+
+uint64_t zigzag(int64_t value) {
+  return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+  return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+int32_t quantizePosition(float position) {
+  return lroundf(position * REPLAY_POSITION_SCALE);
+}
+
+// angle and death packed into one value
+int32_t quantizeHeading(float angle, bool dead) {
+  int32_t steps = int32_t(modAngle(angle) / (M_PI * 2) * REPLAY_ANGLE_STEPS) % REPLAY_ANGLE_STEPS;
+  return steps | (dead ? REPLAY_ANGLE_STEPS : 0);
+}
+
+// heading deltas wrap around so turning past zero stays small
+int32_t headingDelta(int32_t from, int32_t to) {
+  const int32_t range = REPLAY_ANGLE_STEPS * 2;
+  return ((to - from + range + REPLAY_ANGLE_STEPS) % range) - REPLAY_ANGLE_STEPS;
+}
+
+struct ReplayFish {
+  Vector2D position;
+  float angle;
+  bool dead;
+};
+
+struct ReplayFrame {
+  vector<ReplayFish> fishes;
+  vector<Vector2D> foods;
+};
+
+struct ReplayGeneration {
+  int generation;
+  int numFishes;
+  int numFrames;
+  vector<array<uint8_t, 3>> colors;
+  vector<uint8_t> data;
+};
+
+class ReplayRecorder {
+private:
+  ofstream file;
+  int every;
+  int selectedFish;
+  bool recording = false;
+
+  ReplayGeneration block;
+  vector<int32_t> fishState;
+  // quantized position of every food by its id
+  map<int, pair<int32_t, int32_t>> foodState;
+
+  bool isRecorded(int fish) const {
+    return selectedFish < 0 || fish == selectedFish;
+  }
+
+  void begin(const NeatPond& pond, int generation) {
+    auto& fishes = pond.getFishes();
+    block.generation = generation;
+    block.numFishes = 0;
+    block.numFrames = 0;
+    block.colors.clear();
+    block.data.clear();
+    for (int i = 0; i < fishes.size(); i++) {
+      if (!isRecorded(i)) { continue; }
+      auto& genes = fishes[i].genes;
+      block.colors.push_back({
+        uint8_t(genes[TRAIT_RED] * 255),
+        uint8_t(genes[TRAIT_GREEN] * 255),
+        uint8_t(genes[TRAIT_BLUE] * 255)
+      });
+      block.numFishes++;
+    }
+    fishState.assign(block.numFishes * 3, 0);
+    foodState.clear();
+    recording = true;
+  }
+
+public:
+  // records every nth generation to path, all fishes when selectedFish < 0
+  ReplayRecorder(const string& path, int every = 1, int selectedFish = -1):
+    every(max(1, every)),
+    selectedFish(selectedFish)
+  {
+    if (path.empty()) { return; }
+    file.open(path, ios::binary);
+    if (!file) {
+      cerr << "Cannot open replay file " << path << endl;
+      return;
+    }
+    vector<uint8_t> header(REPLAY_MAGIC, REPLAY_MAGIC + 4);
+    writeVarint(header, REPLAY_VERSION);
+    writeVarint(header, REPLAY_POSITION_SCALE);
+    writeVarint(header, REPLAY_ANGLE_STEPS);
+    file.write((const char*)header.data(), header.size());
+  }
+
+  bool isOpen() const {
+    return file.is_open();
+  }
+
+  // call once per tick after NeatPond::update, a new generation
+  // number finishes the previous recording
+  void recordTick(const NeatPond& pond, int generation) {
+    if (recording && generation != block.generation) { endGeneration(); }
+    if (!isOpen() || generation % every != 0) { return; }
+    if (!recording) { begin(pond, generation); }
+
+    auto& out = block.data;
+    auto& fishes = pond.getFishes();
+    int slot = 0;
+    for (int i = 0; i < fishes.size() && slot < block.numFishes; i++) {
+      if (!isRecorded(i)) { continue; }
+      auto& fish = fishes[i];
+      int32_t x = quantizePosition(fish.position.x);
+      int32_t y = quantizePosition(fish.position.y);
+      int32_t heading = quantizeHeading(fish.angle, fish.dead);
+      int32_t* state = &fishState[slot * 3];
+      writeVarint(out, zigzag(x - state[0]));
+      writeVarint(out, zigzag(y - state[1]));
+      writeVarint(out, zigzag(headingDelta(state[2], heading)));
+      state[0] = x;
+      state[1] = y;
+      state[2] = heading;
+      slot++;
+    }
+
+    // food is written by id, as the foods that appeared or moved since
+    // the last frame and then the ids that are gone
+    map<int, pair<int32_t, int32_t>> foods;
+    pond.forFood([&](const Food& food) {
+      foods[food.id] = { quantizePosition(food.position.x), quantizePosition(food.position.y) };
+    });
+    vector<int> changed;
+    vector<int> removed;
+    for (auto& food : foods) {
+      auto found = foodState.find(food.first);
+      if (found == foodState.end() || found->second != food.second) {
+        changed.push_back(food.first);
+      }
+    }
+    for (auto& food : foodState) {
+      if (foods.find(food.first) == foods.end()) {
+        removed.push_back(food.first);
+      }
+    }
+    writeVarint(out, changed.size());
+    int last = 0;
+    for (auto id : changed) {
+      writeVarint(out, id - last);
+      writeVarint(out, zigzag(foods[id].first));
+      writeVarint(out, zigzag(foods[id].second));
+      last = id;
+    }
+    writeVarint(out, removed.size());
+    last = 0;
+    for (auto id : removed) {
+      writeVarint(out, id - last);
+      last = id;
+    }
+    foodState.swap(foods);
+
+    block.numFrames++;
+  }
+
+  // call before NeatPond::reset, writes out the recorded generation
+  void endGeneration() {
+    if (!recording) { return; }
+    vector<uint8_t> header;
+    writeVarint(header, block.generation);
+    writeVarint(header, block.numFishes);
+    for (auto& color : block.colors) {
+      header.insert(header.end(), color.begin(), color.end());
+    }
+    writeVarint(header, block.numFrames);
+    writeVarint(header, block.data.size());
+    file.write((const char*)header.data(), header.size());
+    file.write((const char*)block.data.data(), block.data.size());
+    file.flush();
+    recording = false;
+  }
+};
+
+class ReplayReader {
+private:
+  const vector<uint8_t>* buffer;
+  size_t offset = 0;
+
+public:
+  ReplayReader(const vector<uint8_t>& buffer, size_t offset = 0):
+    buffer(&buffer),
+    offset(offset) { }
+
+  bool done() const {
+    return offset >= buffer->size();
+  }
+
+  size_t tell() const {
+    return offset;
+  }
+
+  void skip(size_t bytes) {
+    offset = min(buffer->size(), offset + bytes);
+  }
+
+  uint8_t byte() {
+    return done() ? 0 : (*buffer)[offset++];
+  }
+
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && !done(); shift += 7) {
+      uint8_t b = (*buffer)[offset++];
+      value |= uint64_t(b & 0x7f) << shift;
+      if (!(b & 0x80)) { break; }
+    }
+    return value;
+  }
+
+  int64_t signedVarint() {
+    return unzigzag(varint());
+  }
+};
+
+// Loads a replay file and decodes one generation at a time for playback.
+class ReplayPlayer {
+private:
+  vector<ReplayGeneration> generations;
+  vector<ReplayFrame> frames;
+  int current = -1;
+  float position = 0.f;
+
+  void decode(int g) {
+    auto& block = generations[g];
+    ReplayReader reader(block.data);
+    vector<int32_t> fishState(block.numFishes * 3, 0);
+    map<int, pair<int32_t, int32_t>> foodState;
+
+    frames.clear();
+    frames.reserve(block.numFrames);
+    for (int t = 0; t < block.numFrames; t++) {
+      ReplayFrame frame;
+      for (int i = 0; i < block.numFishes; i++) {
+        int32_t* state = &fishState[i * 3];
+        state[0] += reader.signedVarint();
+        state[1] += reader.signedVarint();
+        state[2] = (state[2] + reader.signedVarint() + REPLAY_ANGLE_STEPS * 2) % (REPLAY_ANGLE_STEPS * 2);
+        frame.fishes.push_back({
+          Vector2D(state[0] / float(REPLAY_POSITION_SCALE), state[1] / float(REPLAY_POSITION_SCALE)),
+          float((state[2] % REPLAY_ANGLE_STEPS) * M_PI * 2 / REPLAY_ANGLE_STEPS),
+          state[2] >= REPLAY_ANGLE_STEPS
+        });
+      }
+      auto numChanges = reader.varint();
+      int id = 0;
+      for (int c = 0; c < numChanges; c++) {
+        id += reader.varint();
+        auto x = reader.signedVarint();
+        auto y = reader.signedVarint();
+        foodState[id] = { int32_t(x), int32_t(y) };
+      }
+      auto numRemoved = reader.varint();
+      id = 0;
+      for (int c = 0; c < numRemoved; c++) {
+        id += reader.varint();
+        foodState.erase(id);
+      }
+      for (auto& food : foodState) {
+        frame.foods.push_back(Vector2D(
+          food.second.first / float(REPLAY_POSITION_SCALE),
+          food.second.second / float(REPLAY_POSITION_SCALE)
+        ));
+      }
+      frames.push_back(move(frame));
+    }
+  }
+
+public:
+  float speed = 1.f;
+  bool paused = false;
+
+  bool load(const string& path) {
+    ifstream file(path, ios::binary);
+    vector<uint8_t> buffer((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (buffer.size() < 4 || memcmp(buffer.data(), REPLAY_MAGIC, 4) != 0) {
+      cerr << "Not a replay file: " << path << endl;
+      return false;
+    }
+    ReplayReader reader(buffer, 4);
+    if (reader.varint() != REPLAY_VERSION ||
+        reader.varint() != REPLAY_POSITION_SCALE ||
+        reader.varint() != REPLAY_ANGLE_STEPS) {
+      cerr << "Unsupported replay version: " << path << endl;
+      return false;
+    }
+
+    while (!reader.done()) {
+      ReplayGeneration block;
+      block.generation = reader.varint();
+      block.numFishes = reader.varint();
+      for (int i = 0; i < block.numFishes; i++) {
+        block.colors.push_back({ reader.byte(), reader.byte(), reader.byte() });
+      }
+      block.numFrames = reader.varint();
+      auto size = reader.varint();
+      auto start = buffer.begin() + reader.tell();
+      reader.skip(size);
+      block.data.assign(start, buffer.begin() + reader.tell());
+      generations.push_back(move(block));
+    }
+
+    if (generations.empty()) {
+      cerr << "Replay has no generations: " << path << endl;
+      return false;
+    }
+    select(0);
+    return true;
+  }
+
+  void select(int g) {
+    g = max(0, min(int(generations.size()) - 1, g));
+    if (g != current) {
+      current = g;
+      decode(g);
+    }
+    position = 0.f;
+  }
+
+  // jumps by a number of frames, clamped to the current generation
+  void seek(float frames) {
+    position = fmax(0.f, fmin(numFrames() - 1, position + frames));
+  }
+
+  // plays on at the current speed and moves on to the next generation
+  void update() {
+    if (paused || frames.empty()) { return; }
+    position += speed;
+    if (position >= numFrames()) {
+      int next = current + 1 < generations.size() ? current + 1 : 0;
+      select(next);
+    } else if (position < 0) {
+      position = 0.f;
+    }
+  }
+
+  int numFrames() const {
+    return frames.size();
+  }
+
+  int frameIndex() const {
+    return int(position);
+  }
+
+  int generation() const {
+    return generations[current].generation;
+  }
+
+  int index() const {
+    return current;
+  }
+
+  const ReplayFrame& frame() const {
+    return frames[frameIndex()];
+  }
+
+  const vector<array<uint8_t, 3>>& colors() const {
+    return generations[current].colors;
+  }
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef selection_h
+#define selection_h
+
+#include "utils.hh"
+#include "options.hh"
+#include "parallel.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+// Indices of the count fittest genomes, in no particular order.
+// Uses a partial selection, so it runs in O(n) instead of sorting.
+vector<int> fittestIndices(const vector<float>& fitnesses, size_t count) {
+  vector<int> indices(fitnesses.size());
+  for (int i = 0; i < indices.size(); i++) { indices[i] = i; }
+  count = min(count, indices.size());
+  if (count > 0 && count < indices.size()) {
+    nth_element(indices.begin(), indices.begin() + count - 1, indices.end(), [&](int a, int b) {
+      return fitnesses[a] > fitnesses[b];
+    });
+  }
+  indices.resize(count);
+  return indices;
+}
+
+// Fills parents[i] with pick(random, i) on all workers, where random
+// is the stream of index i.
+template<class F>
+vector<int> pickParents(size_t count, uint64_t seed, F pick) {
+  vector<int> parents(count);
+  workers().parallelFor(count, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; i++) {
+      RandomStream random(seed, i);
+      parents[i] = pick(random);
+    }
+  });
+  return parents;
+}
+
+// The original mating pool: genomes are ranked by fitness and enter
+// the pool with a probability that grows linearly with their rank.
+vector<int> selectRank(const vector<float>& fitnesses, size_t count, uint64_t seed) {
+  auto numGenomes = fitnesses.size();
+  vector<int> ranked(numGenomes);
+  vector<int> matingPool;
+
+  for (int i = 0; i < numGenomes; i++) { ranked[i] = i; }
+  sort(ranked.begin(), ranked.end(), [&](int a, int b) {
+    return fitnesses[a] < fitnesses[b];
+  });
+
+  // the streams below count are the picks'
+  RandomStream random(seed, count);
+  while (matingPool.size() == 0) {
+    for (int i = 0; i < numGenomes; i++) {
+      if (random.uniform() < (i + 1) / (float)numGenomes * 2) {
+        matingPool.push_back(ranked[i]);
+      }
+    }
+  }
+
+  return pickParents(count, seed, [&](RandomStream& random) {
+    return matingPool[random.below(matingPool.size())];
+  });
+}
+
+vector<int> selectTournament(const vector<float>& fitnesses, size_t count, int tournamentSize, uint64_t seed) {
+  return pickParents(count, seed, [&](RandomStream& random) {
+    int winner = random.below(fitnesses.size());
+    for (int k = 1; k < tournamentSize; k++) {
+      int challenger = random.below(fitnesses.size());
+      if (fitnesses[challenger] > fitnesses[winner]) {
+        winner = challenger;
+      }
+    }
+    return winner;
+  });
+}
+
+// Stochastic universal sampling: fitness proportionate selection with
+// evenly spaced pointers, which keeps the spread of offspring counts low.
+vector<int> selectSUS(const vector<float>& fitnesses, size_t count, uint64_t seed) {
+  vector<int> parents;
+  vector<double> cumulative;
+  double fitnessSum = 0.0;
+  for (auto f : fitnesses) {
+    fitnessSum += fmax(0.f, f);
+    cumulative.push_back(fitnessSum);
+  }
+
+  RandomStream random(seed, count);
+  if (fitnessSum <= 0.0) {
+    parents = pickParents(count, seed, [&](RandomStream& random) {
+      return int(random.below(fitnesses.size()));
+    });
+  } else {
+    // pointer i lands on the first genome whose cumulative fitness
+    // passes it, so every pointer can be placed on its own
+    double spacing = fitnessSum / count;
+    double offset = random.uniform() * spacing;
+    int last = fitnesses.size() - 1;
+    parents.resize(count);
+    workers().parallelFor(count, [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; i++) {
+        double pointer = offset + i * spacing;
+        int g = upper_bound(cumulative.begin(), cumulative.end(), pointer) - cumulative.begin();
+        parents[i] = min(g, last);
+      }
+    });
+  }
+
+  // the pointers visit genomes in order, shuffle so pairs are random
+  for (int i = parents.size(); i > 1; i--) {
+    swap(parents[i - 1], parents[random.below(i)]);
+  }
+  return parents;
+}
+
+vector<int> selectTruncation(const vector<float>& fitnesses, size_t count, float truncation, uint64_t seed) {
+  auto best = fittestIndices(fitnesses, max<size_t>(1, fitnesses.size() * truncation));
+  return pickParents(count, seed, [&](RandomStream& random) {
+    return best[random.below(best.size())];
+  });
+}
+
+// Picks count parent indices according to the selection strategy. The
+// picks are spread over the workers, with random streams derived from
+// seed so the result does not depend on the number of threads.
+vector<int> selectParents(const Selection& selection, const vector<float>& fitnesses, size_t count, uint64_t seed) {
+  if (fitnesses.empty() || count == 0) { return {}; }
+  switch (selection.strategy) {
+    case SELECTION_TOURNAMENT:
+      return selectTournament(fitnesses, count, max(1, selection.tournamentSize), seed);
+    case SELECTION_SUS:
+      return selectSUS(fitnesses, count, seed);
+    case SELECTION_TRUNCATION:
+      return selectTruncation(fitnesses, count, selection.truncation, seed);
+    default:
+      return selectRank(fitnesses, count, seed);
+  }
+}
+
+#endif
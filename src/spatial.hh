@@ -0,0 +1,91 @@
+#ifndef spatial_h
+#define spatial_h
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// Uniform grid over the square [0, worldSize]². It is rebuilt from
+// scratch with a counting sort, which costs O(n + cells), and keeps a
+// copy of every point in cell order, so queries walk contiguous memory
+// and never touch the objects the points came from. That also makes it
+// safe to query while those objects are being moved on other threads.
+class SpatialGrid {
+public:
+  struct Entry {
+    float x;
+    float y;
+    int id;
+    bool dead;
+  };
+
+private:
+  float cellSize;
+  int cellsPerSide;
+  // entries of cell c are entries[cellStart[c], cellStart[c + 1])
+  vector<int> cellStart;
+  vector<Entry> entries;
+  vector<int> cellOf;
+
+  int cellCoordinate(float value) const {
+    return max(0, min(cellsPerSide - 1, int(value / cellSize)));
+  }
+
+public:
+  // cells grow past cellSize in worlds so large that maxCellsPerSide
+  // cells would not cover them, which keeps a rebuild cheap
+  SpatialGrid(float worldSize = 1, float cellSize = 1, int maxCellsPerSide = 256):
+    cellsPerSide(max(1, min(maxCellsPerSide, int(ceil(worldSize / cellSize))))),
+    cellStart(cellsPerSide * cellsPerSide + 1, 0)
+  {
+    this->cellSize = fmax(cellSize, worldSize / cellsPerSide);
+  }
+
+  size_t size() const {
+    return entries.size();
+  }
+
+  void build(const vector<Entry>& points) {
+    fill(cellStart.begin(), cellStart.end(), 0);
+    cellOf.resize(points.size());
+    for (int i = 0; i < points.size(); i++) {
+      int cell = cellCoordinate(points[i].y) * cellsPerSide + cellCoordinate(points[i].x);
+      cellOf[i] = cell;
+      cellStart[cell + 1]++;
+    }
+    for (int c = 0; c + 1 < cellStart.size(); c++) {
+      cellStart[c + 1] += cellStart[c];
+    }
+
+    // fill every cell from its end so the points keep their order
+    entries.resize(points.size());
+    for (int i = points.size(); i--;) {
+      entries[--cellStart[cellOf[i] + 1]] = points[i];
+    }
+    // now cellStart[c + 1] holds the start of cell c, shift it back
+    for (int c = 0; c + 1 < cellStart.size(); c++) {
+      cellStart[c] = cellStart[c + 1];
+    }
+    cellStart.back() = points.size();
+  }
+
+  // calls visit(entry) for every point in the cells overlapping the
+  // square of half size radius around (x, y); callers filter exactly
+  template<class F>
+  void query(float x, float y, float radius, F visit) const {
+    int left = cellCoordinate(x - radius);
+    int right = cellCoordinate(x + radius);
+    int top = cellCoordinate(y - radius);
+    int bottom = cellCoordinate(y + radius);
+    for (int cy = top; cy <= bottom; cy++) {
+      int row = cy * cellsPerSide;
+      for (int e = cellStart[row + left]; e < cellStart[row + right + 1]; e++) {
+        visit(entries[e]);
+      }
+    }
+  }
+};
+
+#endif
@@ -1,6 +1,40 @@
 #ifndef utils_h
 #define utils_h
 
+#include <cstddef>
+#include <cstdint>
+
 #define RANDOM_NUM ( rand() / double(RAND_MAX) )
 
+// Counter based random numbers (SplitMix64). A stream is determined by
+// its seed and index alone, so work split over threads draws the same
+// numbers no matter which thread runs which index.
+struct RandomStream {
+  uint64_t state;
+
+  static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  RandomStream(uint64_t seed, uint64_t index = 0):
+    state(mix(seed + mix(index + 0x9E3779B97F4A7C15ULL))) { }
+
+  uint64_t next() {
+    state += 0x9E3779B97F4A7C15ULL;
+    return mix(state);
+  }
+
+  // uniform in [0, 1)
+  double uniform() {
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  // uniform in [0, n)
+  size_t below(size_t n) {
+    return uniform() * n;
+  }
+};
+
 #endif
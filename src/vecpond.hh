@@ -0,0 +1,102 @@
+#ifndef vecpond_h
+#define vecpond_h
+
+#include "pond.hh"
+#include "parallel.hh"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Steps several independent ponds in lockstep. The fishes of all ponds
+// are moved as one batch on the worker pool, while food, eating and
+// generations stay private to each pond.
+class VecPond {
+private:
+  vector<unique_ptr<NeatPond>> ponds;
+  vector<int> ticks;
+  vector<int> generations;
+  // milliseconds the last reproduction of each pond took
+  vector<double> reproduceTimes;
+  // offsets[e] is the index of the first fish of pond e in the batch
+  vector<size_t> offsets;
+
+  void updateOffsets() {
+    offsets.resize(ponds.size() + 1);
+    offsets[0] = 0;
+    for (int e = 0; e < ponds.size(); e++) {
+      offsets[e + 1] = offsets[e] + ponds[e]->numFishes();
+    }
+  }
+
+public:
+  VecPond(int numEnvironments) {
+    for (int e = 0; e < numEnvironments; e++) {
+      ponds.emplace_back(new NeatPond());
+      ticks.push_back(0);
+      generations.push_back(0);
+      reproduceTimes.push_back(0.0);
+    }
+    updateOffsets();
+  }
+
+  size_t size() const {
+    return ponds.size();
+  }
+
+  size_t numFishes() const {
+    return offsets.back();
+  }
+
+  const NeatPond& getPond(int e) const {
+    return *ponds[e];
+  }
+
+  int getGeneration(int e) const {
+    return generations[e];
+  }
+
+  double getReproduceTime(int e) const {
+    return reproduceTimes[e];
+  }
+
+  // advances every pond by one tick, calls onTick(e) for every pond
+  // once it has eaten and onGeneration(e, fitness) for each pond that
+  // then finished a generation
+  template<class T, class F>
+  void update(T onTick, F onGeneration) {
+    workers().parallelFor(numFishes(), [this](size_t begin, size_t end) {
+      auto e = upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+      while (begin < end) {
+        auto last = min(end, offsets[e + 1]);
+        ponds[e]->move(begin - offsets[e], last - offsets[e]);
+        begin = last;
+        e++;
+      }
+    });
+
+    bool resized = false;
+    for (int e = 0; e < ponds.size(); e++) {
+      ponds[e]->feed();
+      onTick(e);
+      if (++ticks[e] > GENERATION_LIFESPAN) {
+        auto reproduceStart = chrono::steady_clock::now();
+        float fitness = ponds[e]->reset();
+        chrono::duration<double, milli> reproduceTime = chrono::steady_clock::now() - reproduceStart;
+        reproduceTimes[e] = reproduceTime.count();
+        onGeneration(e, fitness);
+        ticks[e] = 0;
+        generations[e]++;
+        resized = true;
+      }
+    }
+
+    if (resized) {
+      updateOffsets();
+    }
+  }
+};
+
+#endif
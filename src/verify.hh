@@ -0,0 +1,158 @@
+#ifndef verify_h
+#define verify_h
+
+#include "pond.hh"
+
+#include <array>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// State that is checksummed on every tick of a verification run.
+enum {
+  CHECK_POSITION,
+  CHECK_ANGLE,
+  CHECK_SPEED,
+  CHECK_ENERGY,
+  CHECK_INPUT,
+  CHECK_OUTPUT,
+  CHECK_FOOD,
+  CHECK_GENES,
+  NUM_CHECKS
+};
+
+const char* CHECK_NAMES[NUM_CHECKS] = {
+  "position", "angle", "speed", "energy", "input", "output", "food", "genes"
+};
+
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// FNV-1a over the exact bits of the values, for bit for bit comparison,
+// plus their plain sum for comparison within a tolerance.
+struct Checksum {
+  uint64_t hash = FNV_OFFSET;
+  double sum = 0.0;
+
+  template<class T>
+  void add(T value) {
+    auto bytes = (const uint8_t*)&value;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    sum += value;
+  }
+
+  template<class T>
+  void add(const vector<T>& values) {
+    for (auto value : values) { add(value); }
+  }
+};
+
+struct TickChecksums {
+  int generation = 0;
+  // -1 is the state before the first tick, GENERATION_LIFESPAN + 1
+  // the reproduction that ends a generation
+  int tick = 0;
+  array<Checksum, NUM_CHECKS> checks;
+};
+
+TickChecksums checksumPond(const NeatPond& pond, int generation, int tick) {
+  TickChecksums result;
+  result.generation = generation;
+  result.tick = tick;
+  auto& checks = result.checks;
+
+  auto addFish = [&](const Fish& fish) {
+    checks[CHECK_POSITION].add(fish.position.x);
+    checks[CHECK_POSITION].add(fish.position.y);
+    checks[CHECK_ANGLE].add(fish.angle);
+    checks[CHECK_SPEED].add(fish.speed);
+    checks[CHECK_SPEED].add(fish.turnSpeed);
+    checks[CHECK_ENERGY].add(fish.energy);
+    checks[CHECK_INPUT].add(fish.input);
+    checks[CHECK_OUTPUT].add(fish.output);
+    checks[CHECK_GENES].add(fish.genes);
+  };
+  for (auto& fish : pond.getFishes()) { addFish(fish); }
+  for (auto& fish : pond.getChampions()) { addFish(fish); }
+  for (auto& food : pond.getFood()) {
+    checks[CHECK_FOOD].add(food.position.x);
+    checks[CHECK_FOOD].add(food.position.y);
+  }
+  return result;
+}
+
+// the options that change the trajectory, the thread count does not
+string trajectoryOptions() {
+  char description[512];
+  snprintf(
+    description, sizeof(description),
+    "quantized %d sense-every %d sense-adaptive %d food-regrowth %.9g steady-state %d "
+    "optimizer %d sigma %.9g learning-rate %.9g "
+    "selection %d elites %d tournament-size %d truncation %.9g novelty %.9g novelty-k %d",
+    options.quantizedBits, options.senseEvery, int(options.senseAdaptive),
+    options.foodRegrowth, int(options.steadyState),
+    options.optimizer, options.sigma, options.learningRate,
+    options.selection.strategy, int(options.selection.elites),
+    options.selection.tournamentSize, options.selection.truncation,
+    options.noveltyWeight, options.noveltyNeighbours
+  );
+  string result = description;
+  for (auto& path : options.championPaths) {
+    result += " champion " + path;
+  }
+  return result;
+}
+
+// Golden files are text: a header naming the run, then one line per
+// tick with the generation, the tick and a hash and sum per check. The
+// header ends in a hash of the options and the options themselves.
+string trajectoryHeader(long seed, int generations) {
+  auto description = trajectoryOptions();
+  uint64_t hash = FNV_OFFSET;
+  for (auto c : description) {
+    hash = (hash ^ uint8_t(c)) * FNV_PRIME;
+  }
+  char hashText[17];
+  snprintf(hashText, sizeof(hashText), "%016" PRIx64, hash);
+  return "neatpond-trajectory 2 seed " + to_string(seed) +
+    " generations " + to_string(generations) +
+    " world " + to_string(WORLD_SIZE) +
+    " fish " + to_string(FISH_AMOUNT) +
+    " food " + to_string(FOOD_AMOUNT) +
+    " eyes " + to_string(FISH_NUM_EYES) +
+    " options " + hashText + " " + description;
+}
+
+void writeChecksums(FILE* file, const TickChecksums& tick) {
+  fprintf(file, "%d %d", tick.generation, tick.tick);
+  for (auto& check : tick.checks) {
+    fprintf(file, " %016" PRIx64 " %.17g", check.hash, check.sum);
+  }
+  fprintf(file, "\n");
+}
+
+bool readChecksums(FILE* file, TickChecksums& tick) {
+  if (fscanf(file, "%d %d", &tick.generation, &tick.tick) != 2) { return false; }
+  for (auto& check : tick.checks) {
+    if (fscanf(file, "%" SCNx64 " %lf", &check.hash, &check.sum) != 2) { return false; }
+  }
+  return true;
+}
+
+// whether a check matches its golden value, bit for bit when tolerance
+// is 0 and otherwise by a sum within tolerance relative to its size
+bool checkMatches(const Checksum& actual, const Checksum& expected, double tolerance) {
+  if (tolerance <= 0) {
+    return actual.hash == expected.hash;
+  }
+  return fabs(actual.sum - expected.sum) <= tolerance * fmax(1.0, fabs(expected.sum));
+}
+
+#endif